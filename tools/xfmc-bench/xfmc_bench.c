@@ -0,0 +1,199 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Xilinx Video FMC userspace benchmark
+ *
+ * Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Times the kernel-agnostic units of the driver (IDT settings solver,
+ * line rate classification, TMDS hysteresis and strategy selection) on
+ * the rates the driver sees. With -v the solver results are printed too,
+ * so that the output of two commits can be compared.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "idt_calc.h"
+#include "xfmc_plan.h"
+
+#define BENCH_XTAL	40000000
+
+/* Same as idt_std_rates and idt_std_bpc_x4 of idt.c */
+static const u32 bench_rates[] = {
+	25175000, 25200000, 27000000, 27027000, 54000000, 54054000,
+	74176000, 74250000, 108000000, 108108000, 148352000, 148500000,
+	296703000, 297000000,
+};
+
+static const u8 bench_bpc_x4[] = { 4, 5, 6, 8 };
+
+static const u32 bench_frl_mbps[] = { 3000, 6000, 8000, 10000, 12000 };
+
+static volatile u64 bench_sink;
+
+static u64 bench_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (u64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void bench_report(const char *name, u64 calls, u64 ns)
+{
+	printf("%-16s %10llu calls %10.1f ns/call\n", name,
+	       (unsigned long long)calls, calls ? (double)ns / calls : 0);
+}
+
+static void bench_print_settings(void)
+{
+	struct idt_settings s;
+	unsigned int i, j;
+	u32 fout;
+	int ret;
+
+	for (i = 0; i < ARRAY_SIZE(bench_rates); i++) {
+		for (j = 0; j < ARRAY_SIZE(bench_bpc_x4); j++) {
+			fout = bench_rates[i] / 4 * bench_bpc_x4[j];
+			if (fout > IDT_8T49N24X_FOUT_MAX)
+				continue;
+
+			memset(&s, 0, sizeof(s));
+			ret = idt_cal_settings(BENCH_XTAL, BENCH_XTAL, fout, &s);
+			printf("%9u: %d ns1 %u ns2 %u n %u nfrac %u int %u frac %u m1 %u pre %u los %u\n",
+			       fout, ret, s.ns1_qx, s.ns2_qx, s.n_qx,
+			       s.nfrac_qx, s.dsm_int, s.dsm_frac, s.m1_x,
+			       s.pre_x, s.los_x);
+		}
+	}
+}
+
+static void bench_idt(unsigned int iters)
+{
+	struct idt_settings s, prev = { 0 };
+	unsigned int n, i, j;
+	u64 start, calls = 0, sum = 0;
+	int divtbl[20];
+	u32 fout;
+
+	start = bench_now_ns();
+	for (n = 0; n < iters; n++) {
+		for (i = 0; i < ARRAY_SIZE(bench_rates); i++) {
+			for (j = 0; j < ARRAY_SIZE(bench_bpc_x4); j++) {
+				fout = bench_rates[i] / 4 * bench_bpc_x4[j];
+				if (fout > IDT_8T49N24X_FOUT_MAX)
+					continue;
+				idt_cal_settings(BENCH_XTAL, BENCH_XTAL, fout,
+						 &s);
+				sum += s.n_qx + s.dsm_frac;
+				calls++;
+			}
+		}
+	}
+	bench_report("idt_cal_settings", calls, bench_now_ns() - start);
+
+	calls = 0;
+	start = bench_now_ns();
+	for (n = 0; n < iters; n++) {
+		for (i = 0; i < ARRAY_SIZE(bench_rates); i++) {
+			sum += idt_get_int_divtable(bench_rates[i], divtbl, 0);
+			calls++;
+		}
+	}
+	bench_report("idt_divtable", calls, bench_now_ns() - start);
+
+	idt_cal_settings(BENCH_XTAL, BENCH_XTAL, bench_rates[0], &prev);
+	calls = 0;
+	start = bench_now_ns();
+	for (n = 0; n < iters * 16; n++) {
+		sum += idt_settings_delta(&prev, &s);
+		calls++;
+	}
+	bench_report("idt_delta", calls, bench_now_ns() - start);
+
+	bench_sink = sum;
+}
+
+static void bench_plan(unsigned int iters)
+{
+	static const u32 margins[XFMC_TMDS_BOUNDS] = { 20, 20 };
+	struct xfmc_request req = { 0 };
+	u32 cost_us[XFMC_STRATEGY_LOCK + 1] = { 100, 400, 900, 5000 };
+	u64 start, calls = 0, sum = 0;
+	unsigned int n, i;
+	u32 mbps, prev = 0;
+
+	start = bench_now_ns();
+	for (n = 0; n < iters; n++) {
+		for (mbps = 250; mbps <= 6000; mbps += 25) {
+			sum += xfmc_rate_classify(0, mbps, 4);
+			calls++;
+		}
+		for (i = 0; i < ARRAY_SIZE(bench_frl_mbps); i++) {
+			sum += xfmc_rate_classify(1, bench_frl_mbps[i], 3);
+			sum += xfmc_rate_classify(1, bench_frl_mbps[i], 4);
+			calls += 2;
+		}
+	}
+	bench_report("rate_classify", calls, bench_now_ns() - start);
+
+	/* Rates sweeping back and forth over both band boundaries */
+	calls = 0;
+	start = bench_now_ns();
+	for (n = 0; n < iters; n++) {
+		for (mbps = 1500; mbps <= 3500; mbps += 5) {
+			prev = xfmc_tmds_hold(prev, mbps, margins);
+			calls++;
+		}
+		for (mbps = 3500; mbps >= 1500; mbps -= 5) {
+			prev = xfmc_tmds_hold(prev, mbps, margins);
+			calls++;
+		}
+	}
+	sum += prev;
+	bench_report("tmds_hold", calls, bench_now_ns() - start);
+
+	calls = 0;
+	start = bench_now_ns();
+	for (n = 0; n < iters * 16; n++) {
+		req.flags = n & (XFMC_REQ_VERIFY | XFMC_REQ_WAIT_LOCK);
+		req.budget_us = (n * 37) % 6000;
+		sum += xfmc_strategy_pick(&req, cost_us, XFMC_STRATEGY_LOCK);
+		calls++;
+	}
+	bench_report("strategy_pick", calls, bench_now_ns() - start);
+
+	bench_sink = sum;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int iters = 10000;
+	int verbose = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:v")) != -1) {
+		switch (opt) {
+		case 'n':
+			iters = strtoul(optarg, NULL, 0);
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n iterations] [-v]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+
+	if (verbose)
+		bench_print_settings();
+
+	bench_idt(iters);
+	bench_plan(iters);
+
+	return 0;
+}
@@ -14,10 +14,13 @@
 #include <linux/module.h>
 #include <linux/of.h>
 #include <linux/of_device.h>
+#include <linux/regmap.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/version.h>
 
+#include "xfmc.h"
+
 /* function prototypes */
 int fmc64_rx_refclk_sel(unsigned int clk_sel);
 int fmc64_tx_refclk_sel(unsigned int clk_sel);
@@ -39,6 +42,8 @@ MODULE_DEVICE_TABLE(of, fmc64_of_table);
 struct fmc64 {
 	struct gpio_chip	chip;
 	struct i2c_client	*client;
+	struct regmap		*regmap;
+	struct xfmc_chip	xfmc;	/* register snapshots */
 	struct mutex	lock;		/* protect 'out' */
 	unsigned int status;	/* current status */
 	unsigned int out;	/* software latch */
@@ -72,20 +77,50 @@ static int i2c_read_le8(struct i2c_client *client)
 	return (int)i2c_smbus_read_byte(client);
 }
 
+/* The expander has no register address, register 0 is the latch */
+static int fmc64_reg_read(void *context, unsigned int reg, unsigned int *val)
+{
+	struct fmc64 *gpio = context;
+	int data;
+
+	data = gpio->read(gpio->client);
+	if (data < 0)
+		return data;
+
+	*val = data;
+
+	return 0;
+}
+
+static const struct regmap_config fmc64_regmap_config = {
+	.reg_bits = 8,
+	.val_bits = 8,
+	.max_register = 0,
+	.reg_read = fmc64_reg_read,
+};
+
+static const struct regmap_range fmc64_dump = regmap_reg_range(0, 0);
+
 static int fmc64_modify_reg(struct fmc64 *gpio, u8 val, u8 mask)
 {
-	unsigned int data;
-	int ret = 0;
+	int data;
+	int ret;
 
+	mutex_lock(&gpio->lock);
 	/* Read data */
 	data = gpio->read(gpio->client);
+	if (data < 0) {
+		ret = data;
+		goto out;
+	}
 	/* Clear masked bits */
 	data &= ~mask;
 	/* Update */
 	data |= (val & mask);
 	/* Write data */
-	gpio->write(gpio->client, data);
-
+	ret = gpio->write(gpio->client, data);
+out:
+	mutex_unlock(&gpio->lock);
 	return ret;
 }
 
@@ -93,20 +128,23 @@ int fmc64_rx_refclk_sel(unsigned int clk_sel)
 {
 	int ret;
 
+	if (!gpio64)
+		return -ENODEV;
+
 	if (clk_sel == rx_refclk_from_si5344) {
 		dev_info(&gpio64->client->dev, "rx refclock from si5344\n");
-		ret |= fmc64_modify_reg(gpio64, 0x41, 0x18);
+		ret = fmc64_modify_reg(gpio64, 0x41, 0x18);
 
 	} else if (clk_sel == rx_refclk_from_cable) {
 		dev_info(&gpio64->client->dev, "rx refclock from cable\n");
-		ret |= fmc64_modify_reg(gpio64, 0x51, 0x18);
+		ret = fmc64_modify_reg(gpio64, 0x51, 0x18);
 	} else {
 		dev_info(&gpio64->client->dev,
 			 "invalid rx ref clock selection\n");
 		return 0;
 	}
 
-	if (ret == 1)
+	if (ret)
 		dev_err(&gpio64->client->dev,
 			"failed to select rx ref clock\n");
 
@@ -118,20 +156,23 @@ int fmc64_tx_refclk_sel(unsigned int clk_sel)
 {
 	int ret;
 
+	if (!gpio64)
+		return -ENODEV;
+
 	if (clk_sel == tx_refclk_from_idt) {
 		dev_info(&gpio64->client->dev, "tx refclock from idt\n");
-		ret |= fmc64_modify_reg(gpio64, 0x41, 0x60);
+		ret = fmc64_modify_reg(gpio64, 0x41, 0x60);
 
 	} else if (clk_sel == tx_refclk_from_si5344) {
 		dev_info(&gpio64->client->dev, "tx refclock from si5344\n");
-		ret |= fmc64_modify_reg(gpio64, 0x01, 0x60);
+		ret = fmc64_modify_reg(gpio64, 0x01, 0x60);
 	} else {
 		dev_info(&gpio64->client->dev,
 			 "invalid tx refclock selection\n");
 		return 0;
 	}
 
-	if (ret == 1)
+	if (ret)
 		dev_err(&gpio64->client->dev,
 			"Failed to select TX Ref clock\r\n");
 
@@ -139,11 +180,18 @@ int fmc64_tx_refclk_sel(unsigned int clk_sel)
 }
 EXPORT_SYMBOL_GPL(fmc64_tx_refclk_sel);
 
+/* Unbind: stop the refclk selections from using the expander */
+static void fmc64_release(void *data)
+{
+	gpio64 = NULL;
+}
+
 static int fmc64_probe(struct i2c_client *client)
 {
 	struct p_data	*pdata = dev_get_platdata(&client->dev);
 	struct device_node		*np = client->dev.of_node;
 	unsigned int			n_latch = 0;
+	struct fmc64			*data;
 	int				status;
 	const struct i2c_device_id *id = i2c_match_id(fmc64_id, client);
 
@@ -155,20 +203,20 @@ static int fmc64_probe(struct i2c_client *client)
 		dev_dbg(&client->dev, "no platform data\n");
 
 	/* Allocate, initialize, and register this gpio_chip. */
-	gpio64 = devm_kzalloc(&client->dev, sizeof(*gpio64), GFP_KERNEL);
-	if (!gpio64)
+	data = devm_kzalloc(&client->dev, sizeof(*data), GFP_KERNEL);
+	if (!data)
 		return -ENOMEM;
 
-	mutex_init(&gpio64->lock);
+	mutex_init(&data->lock);
 
-	gpio64->chip.base			= pdata ? pdata->gpio_base : -1;
-	gpio64->chip.parent		= &client->dev;
-	gpio64->chip.owner		= THIS_MODULE;
-	gpio64->chip.ngpio		= id->driver_data;
+	data->chip.base			= pdata ? pdata->gpio_base : -1;
+	data->chip.parent		= &client->dev;
+	data->chip.owner		= THIS_MODULE;
+	data->chip.ngpio		= id->driver_data;
 
-	if (gpio64->chip.ngpio == 8) {
-		gpio64->write	= i2c_write_le8;
-		gpio64->read	= i2c_read_le8;
+	if (data->chip.ngpio == 8) {
+		data->write	= i2c_write_le8;
+		data->read	= i2c_read_le8;
 
 		if (!i2c_check_functionality(client->adapter,
 					     I2C_FUNC_SMBUS_BYTE))
@@ -184,18 +232,40 @@ static int fmc64_probe(struct i2c_client *client)
 	if (status < 0)
 		goto fail;
 
-	gpio64->chip.label = client->name;
-	gpio64->client = client;
-	i2c_set_clientdata(client, gpio64);
-	gpio64->out = ~n_latch;
-	gpio64->status = gpio64->out;
+	data->chip.label = client->name;
+	data->client = client;
+	i2c_set_clientdata(client, data);
+	data->out = ~n_latch;
+	data->status = data->out;
 
-	status = devm_gpiochip_add_data(&client->dev, &gpio64->chip, gpio64);
+	status = devm_gpiochip_add_data(&client->dev, &data->chip, data);
 	if (status < 0)
 		goto fail;
 
 	/* init fmc64 */
-	gpio64->write(gpio64->client, 0x41);
+	data->write(data->client, 0x41);
+
+	data->regmap = devm_regmap_init(&client->dev, NULL, data,
+					&fmc64_regmap_config);
+	if (IS_ERR(data->regmap)) {
+		status = PTR_ERR(data->regmap);
+		goto fail;
+	}
+
+	data->xfmc.name = "fmc64";
+	data->xfmc.dev = &client->dev;
+	data->xfmc.regmap = data->regmap;
+	data->xfmc.dump = &fmc64_dump;
+	data->xfmc.num_dump = 1;
+	status = xfmc_chip_register(&data->xfmc);
+	if (status)
+		goto fail;
+
+	/* Published last, the refclk selections only see a probed expander */
+	status = devm_add_action_or_reset(&client->dev, fmc64_release, NULL);
+	if (status)
+		goto fail;
+	gpio64 = data;
 
 	return 0;
 
@@ -242,3 +312,7 @@ EXPORT_SYMBOL_GPL(fmc64_entry);
 
 MODULE_DESCRIPTION("FMC64 Expander driver");
 MODULE_LICENSE("GPL v2");
+
+#if IS_ENABLED(CONFIG_VIDEO_XFMC_HDMI21_KUNIT_TEST)
+#include "fmc64_test.c"
+#endif
@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * FMC64 expander KUnit tests, included by fmc64.c
+ *
+ * Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Stresses the mux read-modify-write of the expander latch from
+ * concurrent workers, each owning one bit.
+ */
+#include <kunit/test.h>
+#include <linux/atomic.h>
+#include <linux/delay.h>
+#include <linux/workqueue.h>
+
+#define FMC64_TEST_WORKERS	8
+#define FMC64_TEST_LOOPS	101	/* odd, each worker ends with its bit set */
+
+static atomic_t fmc64_test_latch;
+
+static int fmc64_test_write(struct i2c_client *client, unsigned int data)
+{
+	atomic_set(&fmc64_test_latch, data);
+
+	return 0;
+}
+
+/* Slow read, a modify in the window would be lost */
+static int fmc64_test_read(struct i2c_client *client)
+{
+	int data = atomic_read(&fmc64_test_latch);
+
+	usleep_range(5, 10);
+
+	return data;
+}
+
+static int fmc64_test_read_fail(struct i2c_client *client)
+{
+	return -EIO;
+}
+
+struct fmc64_test_worker {
+	struct work_struct work;
+	struct fmc64 *gpio;
+	u8 bit;
+	int ret;
+};
+
+static void fmc64_test_work(struct work_struct *work)
+{
+	struct fmc64_test_worker *w = container_of(work,
+						   struct fmc64_test_worker,
+						   work);
+	unsigned int i;
+
+	for (i = 0; i < FMC64_TEST_LOOPS && !w->ret; i++)
+		w->ret = fmc64_modify_reg(w->gpio, i & 1 ? 0 : w->bit, w->bit);
+}
+
+static struct fmc64 *fmc64_test_gpio(struct kunit *test)
+{
+	struct fmc64 *gpio;
+
+	gpio = kunit_kzalloc(test, sizeof(*gpio), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, gpio);
+
+	mutex_init(&gpio->lock);
+	gpio->read = fmc64_test_read;
+	gpio->write = fmc64_test_write;
+
+	return gpio;
+}
+
+static void fmc64_test_modify_stress(struct kunit *test)
+{
+	struct fmc64 *gpio = fmc64_test_gpio(test);
+	struct fmc64_test_worker *w;
+	struct workqueue_struct *wq;
+	unsigned int i;
+
+	w = kunit_kcalloc(test, FMC64_TEST_WORKERS, sizeof(*w), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, w);
+
+	wq = alloc_workqueue("fmc64-test", WQ_UNBOUND, FMC64_TEST_WORKERS);
+	KUNIT_ASSERT_NOT_NULL(test, wq);
+
+	atomic_set(&fmc64_test_latch, 0);
+	for (i = 0; i < FMC64_TEST_WORKERS; i++) {
+		w[i].gpio = gpio;
+		w[i].bit = BIT(i);
+		INIT_WORK(&w[i].work, fmc64_test_work);
+		queue_work(wq, &w[i].work);
+	}
+	destroy_workqueue(wq);
+
+	for (i = 0; i < FMC64_TEST_WORKERS; i++)
+		KUNIT_EXPECT_EQ_MSG(test, w[i].ret, 0, "worker %u", i);
+	KUNIT_EXPECT_EQ(test, atomic_read(&fmc64_test_latch), 0xff);
+
+	mutex_destroy(&gpio->lock);
+}
+
+static void fmc64_test_modify_error(struct kunit *test)
+{
+	struct fmc64 *gpio = fmc64_test_gpio(test);
+
+	/* Only the masked bits change */
+	atomic_set(&fmc64_test_latch, 0x5a);
+	KUNIT_EXPECT_EQ(test, fmc64_modify_reg(gpio, 0x41, 0x18), 0);
+	KUNIT_EXPECT_EQ(test, atomic_read(&fmc64_test_latch), 0x42);
+
+	/* A failed read is returned and nothing is written */
+	gpio->read = fmc64_test_read_fail;
+	KUNIT_EXPECT_EQ(test, fmc64_modify_reg(gpio, 0xff, 0xff), -EIO);
+	KUNIT_EXPECT_EQ(test, atomic_read(&fmc64_test_latch), 0x42);
+
+	mutex_destroy(&gpio->lock);
+}
+
+static struct kunit_case fmc64_test_cases[] = {
+	KUNIT_CASE(fmc64_test_modify_error),
+	KUNIT_CASE_SLOW(fmc64_test_modify_stress),
+	{}
+};
+
+static struct kunit_suite fmc64_test_suite = {
+	.name = "xfmc-fmc64",
+	.test_cases = fmc64_test_cases,
+};
+
+kunit_test_suite(fmc64_test_suite);
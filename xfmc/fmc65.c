@@ -14,10 +14,13 @@
 #include <linux/module.h>
 #include <linux/of.h>
 #include <linux/of_device.h>
+#include <linux/regmap.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/version.h>
 
+#include "xfmc.h"
+
 int fmc65_tx_refclk_sel(unsigned int clk_sel);
 int fmc65_rx_refclk_sel(unsigned int clk_sel);
 int fmc65_entry(void);
@@ -38,6 +41,8 @@ MODULE_DEVICE_TABLE(of, fmc65_of_table);
 struct fmc65 {
 	struct gpio_chip	chip;
 	struct i2c_client	*client;
+	struct regmap		*regmap;
+	struct xfmc_chip	xfmc;	/* register snapshots */
 	struct mutex	lock;	/* protect 'out' */
 	unsigned int	status;	/* current status */
 	unsigned int	out;	/* software latch */
@@ -69,19 +74,50 @@ static int i2c_read_le8(struct i2c_client *client)
 	return (int)i2c_smbus_read_byte(client);
 }
 
+/* The expander has no register address, register 0 is the latch */
+static int fmc65_reg_read(void *context, unsigned int reg, unsigned int *val)
+{
+	struct fmc65 *gpio = context;
+	int data;
+
+	data = gpio->read(gpio->client);
+	if (data < 0)
+		return data;
+
+	*val = data;
+
+	return 0;
+}
+
+static const struct regmap_config fmc65_regmap_config = {
+	.reg_bits = 8,
+	.val_bits = 8,
+	.max_register = 0,
+	.reg_read = fmc65_reg_read,
+};
+
+static const struct regmap_range fmc65_dump = regmap_reg_range(0, 0);
+
 static int fmc65_modify_reg(struct fmc65 *gpio, u8 val, u8 mask)
 {
-	unsigned int data;
-	int ret = 0;
+	int data;
+	int ret;
+
+	mutex_lock(&gpio->lock);
 	/* Read data */
 	data = gpio->read(gpio->client);
+	if (data < 0) {
+		ret = data;
+		goto out;
+	}
 	/* Clear masked bits */
 	data &= ~mask;
 	/* Update */
 	data |= (val & mask);
 	/* Write data */
-	gpio->write(gpio->client, data);
-
+	ret = gpio->write(gpio->client, data);
+out:
+	mutex_unlock(&gpio->lock);
 	return ret;
 }
 
@@ -89,30 +125,40 @@ int fmc65_tx_refclk_sel(unsigned int clk_sel)
 {
 	int ret;
 
+	if (!gpio)
+		return -ENODEV;
+
 	if (clk_sel == tx_refclk_from_idt) {
 		dev_info(&gpio->client->dev, "tx refclock from IDT\n");
-		ret |= fmc65_modify_reg(gpio, 0x1A, 0x08);
+		ret = fmc65_modify_reg(gpio, 0x1A, 0x08);
 
 	} else if (clk_sel == tx_refclk_from_si5344) {
 		dev_info(&gpio->client->dev, "tx refclock from si5344\n");
-		ret |= fmc65_modify_reg(gpio, 0x12, 0x08);
+		ret = fmc65_modify_reg(gpio, 0x12, 0x08);
 	} else {
 		dev_info(&gpio->client->dev, "invalid tx refclock selection\n");
 		return 0;
 	}
 
-	if (ret == 1)
+	if (ret)
 		dev_info(&gpio->client->dev, "failed to select tx refclock\n");
 
 	return ret;
 }
 EXPORT_SYMBOL_GPL(fmc65_tx_refclk_sel);
 
+/* Unbind: stop the refclk selections from using the expander */
+static void fmc65_release(void *data)
+{
+	gpio = NULL;
+}
+
 static int fmc65_probe(struct i2c_client *client)
 {
 	struct p_data	*pdata = dev_get_platdata(&client->dev);
 	struct device_node		*np = client->dev.of_node;
 	unsigned int			n_latch = 0;
+	struct fmc65			*data;
 	int				status;
 	const struct i2c_device_id *id = i2c_match_id(fmc65_id, client);
 
@@ -124,20 +170,20 @@ static int fmc65_probe(struct i2c_client *client)
 		dev_dbg(&client->dev, "no platform data\n");
 
 	/* Allocate, initialize, and register this gpio_chip. */
-	gpio = devm_kzalloc(&client->dev, sizeof(*gpio), GFP_KERNEL);
-	if (!gpio)
+	data = devm_kzalloc(&client->dev, sizeof(*data), GFP_KERNEL);
+	if (!data)
 		return -ENOMEM;
 
-	mutex_init(&gpio->lock);
+	mutex_init(&data->lock);
 
-	gpio->chip.base			= pdata ? pdata->gpio_base : -1;
-	gpio->chip.parent		= &client->dev;
-	gpio->chip.owner		= THIS_MODULE;
-	gpio->chip.ngpio		= id->driver_data;
+	data->chip.base			= pdata ? pdata->gpio_base : -1;
+	data->chip.parent		= &client->dev;
+	data->chip.owner		= THIS_MODULE;
+	data->chip.ngpio		= id->driver_data;
 
-	if (gpio->chip.ngpio == 8) {
-		gpio->write	= i2c_write_le8;
-		gpio->read	= i2c_read_le8;
+	if (data->chip.ngpio == 8) {
+		data->write	= i2c_write_le8;
+		data->read	= i2c_read_le8;
 
 		if (!i2c_check_functionality(client->adapter,
 					     I2C_FUNC_SMBUS_BYTE))
@@ -154,19 +200,41 @@ static int fmc65_probe(struct i2c_client *client)
 	if (status < 0)
 		goto fail;
 
-	gpio->chip.label = client->name;
+	data->chip.label = client->name;
 
-	gpio->client = client;
-	i2c_set_clientdata(client, gpio);
+	data->client = client;
+	i2c_set_clientdata(client, data);
 
-	gpio->out = ~n_latch;
-	gpio->status = gpio->out;
+	data->out = ~n_latch;
+	data->status = data->out;
 
-	status = devm_gpiochip_add_data(&client->dev, &gpio->chip, gpio);
+	status = devm_gpiochip_add_data(&client->dev, &data->chip, data);
 	if (status < 0)
 		goto fail;
 	/* init fmc65 */
-	gpio->write(gpio->client, 0x1A);
+	data->write(data->client, 0x1A);
+
+	data->regmap = devm_regmap_init(&client->dev, NULL, data,
+					&fmc65_regmap_config);
+	if (IS_ERR(data->regmap)) {
+		status = PTR_ERR(data->regmap);
+		goto fail;
+	}
+
+	data->xfmc.name = "fmc65";
+	data->xfmc.dev = &client->dev;
+	data->xfmc.regmap = data->regmap;
+	data->xfmc.dump = &fmc65_dump;
+	data->xfmc.num_dump = 1;
+	status = xfmc_chip_register(&data->xfmc);
+	if (status)
+		goto fail;
+
+	/* Published last, the refclk selections only see a probed expander */
+	status = devm_add_action_or_reset(&client->dev, fmc65_release, NULL);
+	if (status)
+		goto fail;
+	gpio = data;
 
 	return 0;
 
@@ -8,6 +8,16 @@
  * This will generate TMDS clock for HDMI 2.1 TX subsystem based on the
  * requested resolution.
  *
+ * By default the output is synthesized from the crystal. Once reference
+ * rates are set through the ref_rates sysfs attribute, the device runs as
+ * jitter attenuator with each input programmed for its own rate, and
+ * ref_select switches between them (0, 1) or lets the device fail over
+ * on loss of signal (auto) without reprogramming the dividers.
+ *
+ * The crystal rate comes from the "idt,xtal-frequency" DT property. The
+ * synthesizer settings of the standard HDMI rates are computed for it in
+ * the background at probe, so that set_rate only looks them up.
+ *
  */
 #include <linux/clk.h>
 #include <linux/clk-provider.h>
@@ -16,45 +26,65 @@
 #include <linux/gpio/consumer.h>
 #include <linux/i2c.h>
 #include <linux/init.h>
+#include <linux/hash.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 #include <linux/module.h>
 #include <linux/of_gpio.h>
 #include <linux/regmap.h>
 #include <linux/slab.h>
 #include <linux/version.h>
+#include <linux/workqueue.h>
+
+#include "idt_calc.h"
+#include "xfmc.h"
 
 #define IDT_8T49N24X_REVID 0x0    		 //!< Device Revision
 #define IDT_8T49N24X_DEVID 0x0607 		 //!< Device ID Code
 
-#define IDT_8T49N24X_XTAL_FREQ 40000000  //!< The freq of the crystal in Hz
-#define IDT_8T49N24X_FVCO_MAX 4000000000 //!< Max VCO Operating Freq in Hz
-#define IDT_8T49N24X_FVCO_MIN 3000000000 //!< Min VCO Operating Freq in Hz
-#define IDT_8T49N24X_FOUT_MAX 400000000  //!< Max Output Freq in Hz
-#define IDT_8T49N24X_FOUT_MIN      8000  //!< Min Output Freq in Hz
-#define IDT_8T49N24X_FIN_MAX 875000000   //!< Max input Freq in Hz
-#define IDT_8T49N24X_FIN_MIN      8000   //!< Min input Freq in Hz
-#define IDT_8T49N24X_FPD_MAX 128000      //!< Max Phase Detector Freq in Hz
-#define IDT_8T49N24X_FPD_MIN   8000      //!< Min Phase Detector Freq in Hz
-#define IDT_8T49N24X_P_MAX 4194304  /* pow(2,22) */  //!< Max P div value
-#define IDT_8T49N24X_M_MAX 16777216 /* pow(2,24) */  //!< Max M mult value
+#define IDT_8T49N24X_XTAL_FREQ 40000000  //!< Default freq of the crystal in Hz
+#define IDT_8T49N24X_LOCK_US 20000       //!< APLL calibration and lock time
+#define IDT_SET_CLOCK_WRITES 43          //!< set_clock() writes, synthesizer mode
+
+#define IDT_8T49N24X_REG_REFSEL 0x0008   //!< Input reference selection
+#define IDT_8T49N24X_REFSEL_MASK 0x07
+#define IDT_8T49N24X_REFSEL_AUTO 0x00    //!< Automatic, switch on LOS
+#define IDT_8T49N24X_REFSEL_IN0  0x04    //!< Manual, input 0
+#define IDT_8T49N24X_REFSEL_IN1  0x05    //!< Manual, input 1
 
 #define DRIVER_NAME "idt"
 
 void idt_exit(void);
 int idt_entry(void);
 
-struct idt_settings {
-	u32 dsm_frac;
-	u32 m1_x;
-	u32 pre_x;
-	u32 los_x;
-	u32 n_qx;
-	u32 nfrac_qx;
-	u16 ns2_qx;
-	u16 dsm_int;
-	u8  ns1_qx;
-	
+#define IDT_CACHE_BITS	6
+
+/*
+ * struct idt_cache_entry - precomputed synthesizer settings of one rate
+ * @work: Work item computing @settings
+ * @idt: Pointer to the device
+ * @fout: Output rate in Hz, 0 for an empty slot
+ * @valid: @settings are computed, read with smp_load_acquire()
+ * @settings: Settings for @fout from the crystal
+ */
+struct idt_cache_entry {
+	struct work_struct work;
+	struct idts *idt;
+	u32 fout;
+	bool valid;
+	struct idt_settings settings;
+};
+
+/* Standard HDMI TMDS character rates, before deep color scaling */
+static const u32 idt_std_rates[] = {
+	25175000, 25200000, 27000000, 27027000, 54000000, 54054000,
+	74176000, 74250000, 108000000, 108108000, 148352000, 148500000,
+	296703000, 297000000,
 };
 
+/* Deep color: 8, 10, 12 and 16 bpc as num/4 */
+static const u8 idt_std_bpc_x4[] = { 4, 5, 6, 8 };
+
 static const struct regmap_config idt_regmap_config = {
 	.reg_bits = 16,
 	.val_bits = 8,
@@ -66,20 +96,42 @@ static const struct regmap_config idt_regmap_config = {
  * @client: Pointer to I2C client
  * @ctrls: idt control structure
  * @regmap: Pointer to regmap structure
- * @lock: Mutex structure
+ * @chip: FMC core chip of the IDT, its lock serializes the operations
+ *	  with the register snapshots
+ * @rate_lock: Serializes idt_clk_set_rate_req() from the programming of the
+ *	       device to the clock framework update
  * @mode_index: Resolution mode index
+ * @settings: Settings last programmed by set_clock(), per input
+ * @settings_valid: @settings holds programmed settings
+ * @in_rate: Reference rate of each input in Hz, 0 if unused
+ * @refsel: Input selection, IDT_8T49N24X_REFSEL_*
+ * @fout: Output rate last programmed without error by set_clock()
+ * @xtal: Crystal rate in Hz
+ * @cache: Settings of the standard rates, open addressed by output rate
+ * @delta: Skip register writes that do not change the cached value
  */
 struct idts {
 	struct clk_hw hw;
 	struct i2c_client *client;
 	struct regmap *regmap;
-	struct mutex lock; /* mutex lock for operations */
+	struct xfmc_chip chip;
+	struct mutex rate_lock; /* held across set_clock() and clk_set_rate() */
 	u32 mode_index;
+	struct idt_settings settings[2];
+	bool settings_valid;
+	u32 in_rate[2];
+	u8 refsel;
+	u32 fout;
+	u32 xtal;
+	struct idt_cache_entry cache[1 << IDT_CACHE_BITS];
+	bool delta;
 };
 
-int set_clock(struct idts *idt, u32 freq_in, u32 freq_out);
+int set_clock(struct idts *idt, u32 freq_in, u32 freq_out,
+	      struct xfmc_request *req);
 
 #define to_idts(_hw)	container_of(_hw, struct idts, hw)
+struct idts *idtdata;
 
 static inline int idt_read_reg(struct idts *priv, u8 addr, u8 *val)
 {
@@ -96,7 +148,10 @@ static inline int idt_write_reg(struct idts *priv, u16 addr, u8 val)
 {
 	int err = 0;
 
-	err = regmap_write(priv->regmap, addr, val);
+	if (priv->delta)
+		err = regmap_update_bits(priv->regmap, addr, 0xff, val);
+	else
+		err = regmap_write(priv->regmap, addr, val);
 	if (err) {
 		dev_dbg(&priv->client->dev,
 			"i2c write failed, addr = %x\n", addr);
@@ -105,301 +160,6 @@ static inline int idt_write_reg(struct idts *priv, u16 addr, u8 val)
 	return err;
 }
 
-static int idt_get_int_divtable(int freq_out, int *divtbl, u8 bypass)
-{
-	int ns1_opts[4] = {1,4,5,6};
-	int index;
-	int ns2_min = 1;
-	int ns2_max = 1;
-	
-	int ns2_tmp;
-	int outdiv_tmp;
-	u32 vco_tmp;
-	int outdiv_min;
-	int outdiv_max;
-	int i;
-	int cnt = 0;
-	int *divtbl_ptr = divtbl;
-	/* ceil(IDT_8T49N24X_fvco_MIN/freq_out) */
-	outdiv_min = (IDT_8T49N24X_FVCO_MIN/freq_out) +
-					(((IDT_8T49N24X_FVCO_MIN % freq_out)==0) ? 0 : 1);
-	/* (int)floor(IDT_8T49N24X_fvco_MAX/freq_out) */
-	outdiv_max = (IDT_8T49N24X_FVCO_MAX/freq_out);
-	
-	if (bypass == true) {
-		index = 0;
-	}
-	else {
-		index = 1;
-	}
-	
-	for (i = index; i < (sizeof(ns1_opts)/sizeof(int)); i++) {
-		/* This is for the case where we want to bypass NS2 */
-		if ((ns1_opts[i] == outdiv_min) || (ns1_opts[i] == outdiv_max)) {
-			ns2_min = 0;
-			ns2_max = 0;
-		}
-	}
-	
-	/* if this test passes, then we know we're not in the bypass case */
-	if (ns2_min == 1) {
-		/* The last element in the list */
-		/* (int)ceil(outdiv_min / ns1_opts[3] / 2) */
-		ns2_min = (outdiv_min / ns1_opts[3] / 2) +
-				((((outdiv_min / ns1_opts[3]) % 2)==0) ? 0 : 1);
-		/* floor(outdiv_max / ns1_opts[index] / 2) */
-		ns2_max = (outdiv_max / ns1_opts[index] / 2);
-		if (ns2_max == 0)
-			/* because we're rounding-down for the max, we may end-up with
-			   it being 0, in which case we need to make it 1 */
-			ns2_max = 1; 
-	}
-	 
-	ns2_tmp = ns2_min;
-	
-	while (ns2_tmp <= ns2_max) {
-		for (i = index; i < (sizeof(ns1_opts)/sizeof(int)); i++) {
-			if (ns2_tmp == 0) {
-				outdiv_tmp = ns1_opts[i];
-			}
-			else {
-				outdiv_tmp = ns1_opts[i] * ns2_tmp * 2;
-			}
-			
-			vco_tmp = freq_out * outdiv_tmp;
-			
-			if ((vco_tmp <= IDT_8T49N24X_FVCO_MAX) &&
-			    (vco_tmp >= IDT_8T49N24X_FVCO_MIN)) {
-				*divtbl_ptr = outdiv_tmp;
-				cnt++;
-				divtbl_ptr++;
-			}
-		}
-		ns2_tmp++;
-	}
-	
-	return cnt;
-}
-
-static int idt_cal_settings(int freq_in, int freq_out, struct idt_settings *settings)
-{
-	int divtbl[20];
-	int divtbl_cnt;
-	int max_div = 0;
-	unsigned int fvco;
-	int ns1;
-	int ns2;
-	int ns1_ratio;
-	int ns2_ratio;
-	unsigned int UpperFBDiv, UpperFBDiv_rem;
-	int dsm_int;
-	u64 dsm_frac;
-	int los;
-	int i;
-	u32 n_q2 = 0;
-	u32 nfrac_q2 = 0;
-	u64 m1 = 0;
-	int p_min;
-	unsigned int frac_numerator;
-	int m1_default;
-	int p_default;
-	int error_tmp = 999999;
-	int error = 99999999;
-
-	int count = 0;
-
-	/* Get the valid integer dividers */
-	divtbl_cnt = idt_get_int_divtable(freq_out, divtbl, false);
-	
-	/* Find the highest divider */
-	for (i = 0; i < divtbl_cnt; i++) {
-		if (max_div < divtbl[i]) {
-			max_div = divtbl[i];
-		}
-	}
-	fvco = freq_out*max_div;
-	
-	/***************************************************/
-	/* INTEGER DIVIDER: Determine NS1 register setting */
-	/***************************************************/
-#if 0	
-	/* Only use the divide-by-1 option for really small divide ratios
-	 * note that this option will never be on the list for the
-	 * Q0 - Q3 dividers
-	 */
-	if (max_div < 4) { 
-		
-	}
-#endif	
-	/* Make sure we can divide the ratio by 4 in NS1 and by 1 or an
-	 * even number in NS2
-	 */
-	if ((max_div == 4) ||
-	    (max_div % 8 == 0)) { 
-		/* Divide by 4 register selection */
-		ns1 = 2;
-	}
-	
-	/* Make sure we can divide the ratio by 5 in NS1 and by 1 or
-	 * an even number in NS2
-	 */
-	if ((max_div == 5) ||
-	    (max_div % 10 == 0)) {
-		/* Divide by 5 register selection */
-		ns1 = 0;
-	}
-	
-	/* Make sure we can divide the ratio by 6 in NS1 and by 1 or
-	 * an even number in NS2
-	 */
-	if ((max_div == 6) ||
-	    (max_div % 12 == 0)) {
-		/* Divide by 6 register setting */
-		ns1 = 1;
-	}
-	
-	/***************************************************/
-	/* INTEGER DIVIDER: Determine NS2 register setting */
-	/***************************************************/
-	
-	switch (ns1) {
-		case (0) :
-			ns1_ratio = 5;
-		break;
-		
-		case (1) :
-			ns1_ratio = 6;
-		break;
-		
-		case (2) :
-			ns1_ratio = 4;
-		break;
-		
-		case (3) :
-			/* This is the bypass (divide-by-1) option */
-			ns1_ratio = 1;
-		break;
-		
-		default :
-			ns1_ratio = 6;
-		break;
-	}
-	
-	/* floor(max_div / ns1_ratio) */
-	ns2_ratio = (max_div / ns1_ratio);
-	
-	/* floor(ns2_ratio/2) */
-	ns2 = (ns2_ratio/2);
-	
-	if (max_div & 1)
-	{
-		frac_numerator = (268435456 >> 1);
-	}
-	else
-	{
-		frac_numerator = 0;
-	}
-	/* This is the case where the fractional portion is 0.
-	 * Due to precision limitations, sometimes fractional portion of the
-	 * Effective divider gets rounded to 1.  This checks for that condition
-	 */
-	if (!(max_div & 1))
-	{
-		/* n_q2 = (int)round(FracDiv / 2.0); */
-		n_q2 = max_div >> 1;
-		nfrac_q2 = 0;
-	}
-	else
-	{
-		/* n_q2 = (int)floor(FracDiv / 2.0); */
-		n_q2 = ((max_div+1)>>1);
-		nfrac_q2 = frac_numerator;
-	}
-
-	/*****************************************************/
-	/* Calculate the Upper Loop Feedback divider setting */
-	/*****************************************************/
-	
-	UpperFBDiv = (fvco) / (2*IDT_8T49N24X_XTAL_FREQ);
-	UpperFBDiv_rem = fvco % (2 * IDT_8T49N24X_XTAL_FREQ);
-
-	/* dsm_int = (int)floor(UpperFBDiv); */
-	dsm_int = (int)(UpperFBDiv);
-	
-	/*dsm_frac =
-	 * 			(int)round((UpperFBDiv - floor(UpperFBDiv))*pow(2,21));
-	 */
-	//dsm_frac = (int)(((UpperFBDiv - (int)UpperFBDiv)*2097152) + 1/2);
-	dsm_frac = ((u64)UpperFBDiv_rem * 2048) + (78125>>1);
-	dsm_frac = dsm_frac/ (78125);
-	
-	/*****************************************************/
-	/* Calculate the Lower Loop Feedback divider and
-	 * input Divider
-	 *****************************************************/
-	
-//	Ratio = fvco/freq_in;
-	
-	p_min = (int)freq_in/IDT_8T49N24X_FPD_MAX;
-	
-	/* This m1 divider sets the input PFD frequency at 128KHz, the set max */
-	/* int M1Min = (int)(fvco/IDT_8T49N24X_FPD_MAX); */
-
-
-	/* Start from lowest divider and iterate until 0 error is found
-	 * or the divider limit is exhausted.
-	 */
-	/* Keep the setting with the lowest error */
-	for (i = p_min; i <= IDT_8T49N24X_P_MAX; i++) {
-		/* m1 = (int)round(i*Ratio); */
-//		m1 = (int)(i*Ratio +  1/2);
-		m1 = (u64)fvco *i;
-		m1 += (freq_in >> 1);
-		m1 /= freq_in;
-		count++;
-		if (m1 < IDT_8T49N24X_M_MAX) {
-			u64 temp = ((u64)fvco*i - (u64)m1*freq_in)*1000000;
-			u64 temp1 = (u64)i*freq_in/1000;
-			temp = temp / temp1;
-			error_tmp = (int)temp;
-//			error_tmp = (int)(Ratio*1000000000 - (m1*1000000000 / i));
-
-			if (abs(error_tmp) < error || error_tmp == 0) {
-				error = abs(error_tmp);
-				m1_default = m1;
-				p_default = i;
-
-				if (error_tmp == 0)
-					break;
-			}
-		}
-		else {
-			break;
-		}
-	}
-	
-	/* Calculate los */
-	los = fvco / 8 / freq_in; 
-	los = los + 3;
-	if (los < 6)
-		los = 6;
-
-	/* Copy registers */
-	settings->ns1_qx = ns1;
-	settings->ns2_qx = ns2;
-	
-	settings->n_qx = n_q2;
-	settings->nfrac_qx = nfrac_q2;
-
-	settings->dsm_int = dsm_int;
-	settings->dsm_frac = dsm_frac;
-	settings->m1_x = m1_default;
-	settings->pre_x = p_default;
-	settings->los_x = los;
-
-	return 0;
-}
-
 static int idt_pre_div(struct idts *idt, u32 val, u8 input)
 {
 	int ret;
@@ -414,10 +174,14 @@ static int idt_pre_div(struct idts *idt, u32 val, u8 input)
 	/* PREx[20:16] */
 	data = (val >> 16) & 0x1f; 
 	ret = idt_write_reg(idt, addr, data);
+	if (ret)
+		return ret;
 
 	/* PREx[15:8] */
 	data = (val >> 8); 
 	ret = idt_write_reg(idt, addr+1, data);
+	if (ret)
+		return ret;
 
 	/* PREx[7:0] */
 	data = (val & 0xff); 
@@ -440,10 +204,14 @@ static int idt_m1_feedback(struct idts *idt, u32 val, u8 input)
 	/* M1x[23:16] */
 	data = (val >> 16); 
 	ret = idt_write_reg(idt, addr, data);
+	if (ret)
+		return ret;
 
 	/* m1x[15:8] */
 	data = (val >> 8); 
 	ret = idt_write_reg(idt, addr+1, data);
+	if (ret)
+		return ret;
 
 	/* M1x[7:0] */
 	data = (val & 0xff); 
@@ -459,6 +227,8 @@ static int idt_dsm_int(struct idts *idt, u16 val)
 	/* dsm_int[8] */
 	data = (val >> 8) & 0x01; 
 	ret = idt_write_reg(idt, 0x0025, data);
+	if (ret)
+		return ret;
 
 	/* dsm_int[7:0] */
 	data = (val & 0xff); 
@@ -475,10 +245,14 @@ static int idt_dsm_frac(struct idts *idt, u32 val)
 	/* dsm_frac[20:16] */
 	data = (val >> 16) & 0x1f; 
 	ret = idt_write_reg(idt, 0x0028, data);
+	if (ret)
+		return ret;
 
 	/* dsm_frac[15:8] */
 	data = (val >> 8); 
 	ret = idt_write_reg(idt, 0x0029, data);
+	if (ret)
+		return ret;
 
 	/* dsm_frac[7:0] */
 	data = (val & 0xff); 
@@ -507,10 +281,14 @@ static int idt_outdiv_int(struct idts *idt, u32 val, u8 output)
 	/* N_Qm[17:16] */
 	data = (val >> 16) & 0x03; 
 	ret = idt_write_reg(idt, addr, data);
+	if (ret)
+		return ret;
 
 	/* N_Qm[15:8] */
 	data = (val >> 8); 
 	ret = idt_write_reg(idt, addr+1, data);
+	if (ret)
+		return ret;
 
 	/* N_Qm[7:0] */
 	data = (val & 0xff); 
@@ -538,14 +316,20 @@ static int idt_outdiv_frac(struct idts *idt, u32 val, u8 output)
 	/* NFRAC_Qm[27:24] */
 	data = (val >> 24) & 0x0f; 
 	ret = idt_write_reg(idt, addr, data);
+	if (ret)
+		return ret;
 
 	/* NFRAC_Qm[23:16] */
 	data = (val >> 16); 
 	ret = idt_write_reg(idt, addr+1, data);
+	if (ret)
+		return ret;
 
 	/* NFRAC_Qm[15:8] */
 	data = (val >> 8); 
 	ret = idt_write_reg(idt, addr+2, data);
+	if (ret)
+		return ret;
 
 	/* NFRAC_Qm[7:0] */
 	data = (val & 0xff); 
@@ -559,7 +343,9 @@ static int idt_modify_reg(struct idts *idt, u16 addr, u8 val, u8 mask)
 	int ret;
 
 	/* Read data */
-	regmap_read(idt->regmap, addr, &data);
+	ret = regmap_read(idt->regmap, addr, &data);
+	if (ret)
+		return ret;
 	/* Clear masked bits */
 	data &= ~mask; 
 
@@ -591,6 +377,8 @@ static int idt_set_mode(struct idts *idt, u8 synthesizer)
 	}
 	mask = 0x33;
 	ret = idt_modify_reg(idt, 0x000a, val, mask);
+	if (ret)
+		return ret;
 	/* Analog PLL: SYN_MODE */
 	if (synthesizer) {
 		val = (1<<3);		/* synthesizer mode */
@@ -618,10 +406,14 @@ static int idt_in_monitor_ctrl(struct idts *idt, u32 val, u8 input)
 	/* losx[16] */
 	data = (val >> 16) & 0x1; 
 	ret = idt_write_reg(idt, addr, data);
+	if (ret)
+		return ret;
 
 	/* losx[15:8] */
 	data = (val >> 8); 
 	ret = idt_write_reg(idt, addr+1, data);
+	if (ret)
+		return ret;
 
 	/* losx[7:0] */
 	data = (val & 0xff); 
@@ -660,10 +452,180 @@ static int idt_ref_input(struct idts *idt, u8 input, u8 enable)
 	return ret;
 }
 
-int set_clock(struct idts *idt, u32 freq_in, u32 freq_out)
+/* Registers written by set_clock() that are read back on verify */
+static const struct {
+	u16 addr;
+	u8 num;
+} idt_verify_regs[] = {
+	{ 0x000b, 12 },		/* PRE0, PRE1, M1_1, M1_0 */
+	{ 0x0025, 2 },		/* DSM_INT */
+	{ 0x0028, 3 },		/* DSM_FRAC */
+	{ 0x0045, 6 },		/* N_Q2, N_Q3 */
+	{ 0x005b, 8 },		/* NFRAC_Q2, NFRAC_Q3 */
+	{ 0x0071, 6 },		/* LOS0, LOS1 */
+};
+
+#define IDT_VERIFY_READS 37
+
+/* Compare the device registers with the values last written */
+static int idt_verify(struct idts *idt)
 {
-	int ret;
-	struct idt_settings settings;
+	unsigned int i, j, addr, val, data;
+	int ret = 0;
+
+	for (i = 0; i < ARRAY_SIZE(idt_verify_regs); i++) {
+		for (j = 0; j < idt_verify_regs[i].num; j++) {
+			addr = idt_verify_regs[i].addr + j;
+
+			ret = regmap_read(idt->regmap, addr, &val);
+			if (ret)
+				return ret;
+
+			regcache_cache_bypass(idt->regmap, true);
+			ret = regmap_read(idt->regmap, addr, &data);
+			regcache_cache_bypass(idt->regmap, false);
+			if (ret)
+				return ret;
+
+			if (data != val) {
+				dev_dbg(&idt->client->dev,
+					"verify failed, addr = %x: %x != %x\n",
+					addr, data, val);
+				return -EIO;
+			}
+		}
+	}
+
+	return ret;
+}
+
+/* Jitter attenuator mode, with at least one reference rate set */
+static bool idt_ja_mode(struct idts *idt)
+{
+	return idt->in_rate[0] || idt->in_rate[1];
+}
+
+/* Register writes of set_clock(), plus REFSEL in jitter attenuator mode */
+static unsigned int idt_set_clock_writes(struct idts *idt)
+{
+	return IDT_SET_CLOCK_WRITES + idt_ja_mode(idt);
+}
+
+/*
+ * Register writes of set_clock() in delta mode: the calibration toggle
+ * of 0x0070 plus the divider bytes that change.
+ */
+static unsigned int idt_delta_writes(struct idts *idt,
+				     const struct idt_settings *new)
+{
+	if (!idt->settings_valid)
+		return idt_set_clock_writes(idt);
+
+	return 2 + idt_settings_delta(idt->settings, new);
+}
+
+static struct idt_cache_entry *idt_cache_slot(struct idts *idt, u32 fout)
+{
+	unsigned int i, n = ARRAY_SIZE(idt->cache);
+	struct idt_cache_entry *e;
+
+	for (i = 0; i < n; i++) {
+		e = &idt->cache[(hash_32(fout, IDT_CACHE_BITS) + i) & (n - 1)];
+		if (e->fout == fout || !e->fout)
+			return e;
+	}
+
+	return NULL;
+}
+
+/* Settings for @freq_in to @freq_out, from the cache if precomputed */
+static void idt_get_settings(struct idts *idt, u32 freq_in, u32 freq_out,
+			     struct idt_settings *settings)
+{
+	struct idt_cache_entry *e;
+
+	if (freq_in == idt->xtal) {
+		e = idt_cache_slot(idt, freq_out);
+		if (e && e->fout == freq_out && smp_load_acquire(&e->valid)) {
+			*settings = e->settings;
+			return;
+		}
+	}
+
+	idt_cal_settings(idt->xtal, freq_in, freq_out, settings);
+}
+
+static void idt_cache_work(struct work_struct *work)
+{
+	struct idt_cache_entry *e = container_of(work, struct idt_cache_entry,
+						 work);
+
+	idt_cal_settings(e->idt->xtal, e->idt->xtal, e->fout, &e->settings);
+	smp_store_release(&e->valid, true);
+}
+
+static void idt_cache_release(void *data)
+{
+	struct idts *idt = data;
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(idt->cache); i++)
+		if (idt->cache[i].fout)
+			cancel_work_sync(&idt->cache[i].work);
+}
+
+/*
+ * Reserve a slot for each standard rate and compute the settings on the
+ * unbound workqueue, one work item per rate. Lookups before a slot is
+ * valid compute the settings themselves.
+ */
+static int idt_cache_init(struct idts *idt)
+{
+	struct idt_cache_entry *e;
+	unsigned int i, j;
+	u32 fout;
+
+	for (i = 0; i < ARRAY_SIZE(idt_std_rates); i++) {
+		for (j = 0; j < ARRAY_SIZE(idt_std_bpc_x4); j++) {
+			fout = idt_std_rates[i] / 4 * idt_std_bpc_x4[j];
+			if (fout > IDT_8T49N24X_FOUT_MAX)
+				continue;
+
+			e = idt_cache_slot(idt, fout);
+			if (!e || e->fout)
+				continue;
+
+			e->idt = idt;
+			e->fout = fout;
+			INIT_WORK(&e->work, idt_cache_work);
+		}
+	}
+
+	for (i = 0; i < ARRAY_SIZE(idt->cache); i++)
+		if (idt->cache[i].fout)
+			queue_work(system_unbound_wq, &idt->cache[i].work);
+
+	return devm_add_action_or_reset(&idt->client->dev, idt_cache_release,
+					idt);
+}
+
+static int idt_ref_select(struct idts *idt, u8 refsel)
+{
+	return idt_modify_reg(idt, IDT_8T49N24X_REG_REFSEL, refsel,
+			      IDT_8T49N24X_REFSEL_MASK);
+}
+
+int set_clock(struct idts *idt, u32 freq_in, u32 freq_out,
+	      struct xfmc_request *req)
+{
+	unsigned int xfers[XFMC_STRATEGY_LOCK + 1];
+	unsigned int bytes[XFMC_STRATEGY_LOCK + 1];
+	u32 cost_us[XFMC_STRATEGY_LOCK + 1];
+	struct idt_settings settings[2];
+	u32 strategy, settle_us;
+	u64 est_ns, ns;
+	ktime_t start;
+	int ret, i;
 
 	if ((freq_in < IDT_8T49N24X_FIN_MIN) &&
 	   (freq_in > IDT_8T49N24X_FIN_MAX)) {
@@ -677,57 +639,169 @@ int set_clock(struct idts *idt, u32 freq_in, u32 freq_out)
 		return 1;
 	}
 	
-	/* Calculate settings */
-	idt_cal_settings(freq_in, freq_out, &settings);
-
-	/* Disable DPLL and APLL calibration */
-	idt_write_reg(idt, 0x0070, 0x05); 
-
-	/* Free running mode */
-	/* Disable reference clock input 0 */
-	ret = idt_ref_input(idt, 0, false);
+	start = ktime_get();
+
+	/* Calculate settings, each input for its own reference rate */
+	for (i = 0; i < 2; i++)
+		idt_get_settings(idt, idt->in_rate[i] ? idt->in_rate[i] : freq_in,
+				 freq_out, &settings[i]);
+
+	xfers[XFMC_STRATEGY_DELTA] = idt_delta_writes(idt, settings);
+	bytes[XFMC_STRATEGY_DELTA] = xfers[XFMC_STRATEGY_DELTA] *
+				     XFMC_WRITE_BYTES(2);
+	xfers[XFMC_STRATEGY_FULL] = idt_set_clock_writes(idt);
+	bytes[XFMC_STRATEGY_FULL] = xfers[XFMC_STRATEGY_FULL] *
+				    XFMC_WRITE_BYTES(2);
+	xfers[XFMC_STRATEGY_VERIFY] = xfers[XFMC_STRATEGY_FULL] +
+				      IDT_VERIFY_READS;
+	bytes[XFMC_STRATEGY_VERIFY] = bytes[XFMC_STRATEGY_FULL] +
+				      IDT_VERIFY_READS * XFMC_READ_BYTES(2);
+	xfers[XFMC_STRATEGY_LOCK] = xfers[XFMC_STRATEGY_VERIFY];
+	bytes[XFMC_STRATEGY_LOCK] = bytes[XFMC_STRATEGY_VERIFY];
+	for (i = 0; i <= XFMC_STRATEGY_LOCK; i++)
+		cost_us[i] = xfmc_cost_us(xfers[i], bytes[i],
+					  i == XFMC_STRATEGY_LOCK ?
+					  IDT_8T49N24X_LOCK_US : 0);
+	strategy = xfmc_strategy_pick(req, cost_us, XFMC_STRATEGY_LOCK);
+	settle_us = strategy == XFMC_STRATEGY_LOCK ? IDT_8T49N24X_LOCK_US : 0;
+	est_ns = (u64)cost_us[strategy] * NSEC_PER_USEC;
+
+	if (req && (req->flags & XFMC_REQ_DRY_RUN)) {
+		req->strategy = strategy;
+		req->estimate_ns = est_ns;
+		req->duration_ns = 0;
+		return 0;
+	}
 
-	/* Disable reference clock input 1 */
-	ret = idt_ref_input(idt, 1, false);
+	idt->delta = strategy == XFMC_STRATEGY_DELTA;
 
-	/* Set synthesizer mode */
-	ret = idt_set_mode(idt, true);
+	/* Disable DPLL and APLL calibration */
+	ret = idt_write_reg(idt, 0x0070, 0x05);
+	if (ret)
+		goto out;
+
+	if (idt_ja_mode(idt)) {
+		/* Set jitter attenuator mode */
+		ret = idt_set_mode(idt, false);
+		if (ret)
+			goto out;
+
+		/* Enable the reference inputs that have a rate */
+		ret = idt_ref_input(idt, 0, idt->in_rate[0] != 0);
+		if (ret)
+			goto out;
+		ret = idt_ref_input(idt, 1, idt->in_rate[1] != 0);
+		if (ret)
+			goto out;
+
+		ret = idt_ref_select(idt, idt->refsel);
+		if (ret)
+			goto out;
+	} else {
+		/* Free running mode */
+		/* Disable reference clock input 0 */
+		ret = idt_ref_input(idt, 0, false);
+		if (ret)
+			goto out;
+
+		/* Disable reference clock input 1 */
+		ret = idt_ref_input(idt, 1, false);
+		if (ret)
+			goto out;
+
+		/* Set synthesizer mode */
+		ret = idt_set_mode(idt, true);
+		if (ret)
+			goto out;
+	}
 
 	/* Pre-divider input 0 */
-	ret = idt_pre_div(idt, settings.pre_x, 0);
+	ret = idt_pre_div(idt, settings[0].pre_x, 0);
+	if (ret)
+		goto out;
 	/* Pre-divider input 1 */
-	ret = idt_pre_div(idt, settings.pre_x, 1);
+	ret = idt_pre_div(idt, settings[1].pre_x, 1);
+	if (ret)
+		goto out;
 	/* M1 feedback input 0 */
-	ret = idt_m1_feedback(idt, settings.m1_x, 0);
+	ret = idt_m1_feedback(idt, settings[0].m1_x, 0);
+	if (ret)
+		goto out;
 	/* M1 feedback input 1 */
-	ret = idt_m1_feedback(idt, settings.m1_x, 1);
+	ret = idt_m1_feedback(idt, settings[1].m1_x, 1);
+	if (ret)
+		goto out;
 
 	/* DSM integer */
-	ret = idt_dsm_int(idt, settings.dsm_int);
+	ret = idt_dsm_int(idt, settings[0].dsm_int);
+	if (ret)
+		goto out;
 
 	/* DSM fractional */
-	ret = idt_dsm_frac(idt, settings.dsm_frac);
+	ret = idt_dsm_frac(idt, settings[0].dsm_frac);
+	if (ret)
+		goto out;
 
 	/* output divider integer output 2 */
-	ret = idt_outdiv_int(idt, settings.n_qx, 2);
+	ret = idt_outdiv_int(idt, settings[0].n_qx, 2);
+	if (ret)
+		goto out;
 
 	/* output divider integer output 3 */
-	ret = idt_outdiv_int(idt, settings.n_qx, 3);
+	ret = idt_outdiv_int(idt, settings[0].n_qx, 3);
+	if (ret)
+		goto out;
 
 	/* output divider fractional output 2 */
-	ret = idt_outdiv_frac(idt, settings.nfrac_qx, 2);
+	ret = idt_outdiv_frac(idt, settings[0].nfrac_qx, 2);
+	if (ret)
+		goto out;
 
 	/* output divider fractional output 3 */
-	ret = idt_outdiv_frac(idt, settings.nfrac_qx, 3);
+	ret = idt_outdiv_frac(idt, settings[0].nfrac_qx, 3);
+	if (ret)
+		goto out;
 
 	/* input monitor control 0 */
-	ret = idt_in_monitor_ctrl(idt, settings.los_x, 0);
+	ret = idt_in_monitor_ctrl(idt, settings[0].los_x, 0);
+	if (ret)
+		goto out;
 
 	/* input monitor control 1 */
-	ret = idt_in_monitor_ctrl(idt, settings.los_x, 1);
+	ret = idt_in_monitor_ctrl(idt, settings[1].los_x, 1);
+	if (ret)
+		goto out;
 
 	/* enable DPLL and APLL calibration */
-	ret = idt_write_reg(idt, 0x0070, 0x00); 
+	ret = idt_write_reg(idt, 0x0070, 0x00);
+out:
+	idt->delta = false;
+	memcpy(idt->settings, settings, sizeof(settings));
+	idt->settings_valid = !ret;
+	/* A failed write leaves the rate of the last good programming */
+	if (!ret)
+		idt->fout = freq_out;
+
+	if (!ret && strategy >= XFMC_STRATEGY_VERIFY)
+		ret = idt_verify(idt);
+
+	/* Wait for the APLL to calibrate and lock */
+	if (!ret && strategy == XFMC_STRATEGY_LOCK)
+		usleep_range(IDT_8T49N24X_LOCK_US, IDT_8T49N24X_LOCK_US + 1000);
+
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	if (!ret)
+		xfmc_cost_done(XFMC_COST_CLOCK, xfmc_req_id(req), xfers[strategy],
+			       bytes[strategy], settle_us, est_ns, ns);
+
+	if (req) {
+		req->strategy = strategy;
+		req->estimate_ns = est_ns;
+		req->duration_ns = ns;
+		dev_dbg(&idt->client->dev, "%llx %u Hz: %s in %llu ns, est %llu ns (budget %u us)\n",
+			req->id, freq_out, xfmc_strategy_name(strategy),
+			req->duration_ns, req->estimate_ns, req->budget_us);
+	}
 
 	return ret;
 }
@@ -739,7 +813,7 @@ static unsigned long idt_recalc_rate(struct clk_hw *hw,
 
 	dev_dbg(&idt->client->dev, "%s \n",__func__);
 
-	return 0;
+	return READ_ONCE(idt->fout);
 }
 
 static long idt_round_rate(struct clk_hw *hw, unsigned long rate,
@@ -756,11 +830,73 @@ static int idt_set_rate(struct clk_hw *hw, unsigned long rate,
 			unsigned long parent_rate)
 {
 	struct idts *idt = to_idts(hw);
-	
-	set_clock(idt, IDT_8T49N24X_XTAL_FREQ,rate);
-	
-	return 0;
+	ktime_t start = ktime_get();
+	int ret;
+
+	mutex_lock(&idt->chip.lock);
+	/* Already programmed by idt_clk_set_rate_req() */
+	if (idt->settings_valid && idt->fout == rate) {
+		mutex_unlock(&idt->chip.lock);
+		return 0;
+	}
+	ret = set_clock(idt, idt->xtal, rate, NULL);
+	mutex_unlock(&idt->chip.lock);
+
+	xfmc_rec_add("clk_rate", 0, rate, 0, start, ret);
+
+	return ret;
+}
+
+int idt_clk_set_rate(unsigned long rate)
+{
+	return idt_clk_set_rate_req(rate, NULL);
+}
+EXPORT_SYMBOL_GPL(idt_clk_set_rate);
+
+/**
+ * idt_clk_set_rate_req - Set the output rate within a latency budget
+ * @rate: output rate in Hz
+ * @req: budget, policy and correlation id, NULL for a full rewrite
+ *
+ * The device is programmed here rather than through the clock framework,
+ * which skips .set_rate for an unchanged rate and could run it for the
+ * rate of another caller. Callers are serialized until the framework rate
+ * is updated, so its .set_rate always finds the device programmed.
+ * @req is filled in whatever the device needed.
+ * With XFMC_REQ_DRY_RUN set in @req, the strategy and its estimated
+ * duration are returned without programming the device.
+ *
+ * Return: 0 for success and error value on failure
+ */
+int idt_clk_set_rate_req(unsigned long rate, struct xfmc_request *req)
+{
+	ktime_t start = ktime_get();
+	struct idts *idt = idtdata;
+	int ret;
+
+	if (!idt)
+		return -ENODEV;
+
+	mutex_lock(&idt->rate_lock);
+	mutex_lock(&idt->chip.lock);
+	ret = set_clock(idt, idt->xtal, rate, req);
+	mutex_unlock(&idt->chip.lock);
+
+	if (req && (req->flags & XFMC_REQ_DRY_RUN))
+		goto out;
+
+	xfmc_rec_add("clk_rate", xfmc_req_id(req), rate, 0, start, ret);
+	if (ret)
+		goto out;
+
+	/* Update the framework rate, .set_rate finds the device programmed */
+	ret = clk_set_rate(idt->hw.clk, rate);
+out:
+	mutex_unlock(&idt->rate_lock);
+
+	return ret;
 }
+EXPORT_SYMBOL_GPL(idt_clk_set_rate_req);
 
 static const struct clk_ops idt_clk_ops = {
 	.recalc_rate = idt_recalc_rate,
@@ -768,6 +904,116 @@ static const struct clk_ops idt_clk_ops = {
 	.set_rate = idt_set_rate,
 };
 
+static ssize_t ref_rates_show(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	struct idts *idt = dev_get_drvdata(dev);
+	ssize_t len;
+
+	mutex_lock(&idt->chip.lock);
+	len = sprintf(buf, "%u %u\n", idt->in_rate[0], idt->in_rate[1]);
+	mutex_unlock(&idt->chip.lock);
+
+	return len;
+}
+
+/*
+ * "<rate0> <rate1>" in Hz, 0 for an unused input. Reprograms the device
+ * for the current output rate; "0 0" goes back to synthesizer mode.
+ */
+static ssize_t ref_rates_store(struct device *dev,
+			       struct device_attribute *attr,
+			       const char *buf, size_t count)
+{
+	struct idts *idt = dev_get_drvdata(dev);
+	u32 rate[2];
+	int ret, i;
+
+	if (sscanf(buf, "%u %u", &rate[0], &rate[1]) != 2)
+		return -EINVAL;
+
+	for (i = 0; i < 2; i++)
+		if (rate[i] && (rate[i] < IDT_8T49N24X_FIN_MIN ||
+				rate[i] > IDT_8T49N24X_FIN_MAX))
+			return -ERANGE;
+
+	mutex_lock(&idt->chip.lock);
+	idt->in_rate[0] = rate[0];
+	idt->in_rate[1] = rate[1];
+	if ((idt->refsel == IDT_8T49N24X_REFSEL_IN0 && !rate[0]) ||
+	    (idt->refsel == IDT_8T49N24X_REFSEL_IN1 && !rate[1]))
+		idt->refsel = IDT_8T49N24X_REFSEL_AUTO;
+	idt->settings_valid = false;
+	ret = 0;
+	if (idt->fout)
+		ret = set_clock(idt, idt->xtal, idt->fout, NULL);
+	mutex_unlock(&idt->chip.lock);
+
+	return ret ? -EIO : count;
+}
+static DEVICE_ATTR_RW(ref_rates);
+
+static ssize_t ref_select_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	struct idts *idt = dev_get_drvdata(dev);
+	const char *sel;
+
+	mutex_lock(&idt->chip.lock);
+	if (idt->refsel == IDT_8T49N24X_REFSEL_IN0)
+		sel = "0";
+	else if (idt->refsel == IDT_8T49N24X_REFSEL_IN1)
+		sel = "1";
+	else
+		sel = "auto";
+	mutex_unlock(&idt->chip.lock);
+
+	return sprintf(buf, "%s\n", sel);
+}
+
+/* "0" or "1" selects an input, "auto" fails over on loss of signal */
+static ssize_t ref_select_store(struct device *dev,
+				struct device_attribute *attr,
+				const char *buf, size_t count)
+{
+	struct idts *idt = dev_get_drvdata(dev);
+	u8 refsel;
+	int ret = 0;
+
+	if (sysfs_streq(buf, "auto"))
+		refsel = IDT_8T49N24X_REFSEL_AUTO;
+	else if (sysfs_streq(buf, "0"))
+		refsel = IDT_8T49N24X_REFSEL_IN0;
+	else if (sysfs_streq(buf, "1"))
+		refsel = IDT_8T49N24X_REFSEL_IN1;
+	else
+		return -EINVAL;
+
+	mutex_lock(&idt->chip.lock);
+	if ((refsel == IDT_8T49N24X_REFSEL_IN0 && !idt->in_rate[0]) ||
+	    (refsel == IDT_8T49N24X_REFSEL_IN1 && !idt->in_rate[1])) {
+		ret = -ENXIO;
+		goto out;
+	}
+
+	idt->refsel = refsel;
+	/* Only the selection changes, the inputs stay programmed */
+	if (idt_ja_mode(idt) && idt->settings_valid)
+		ret = idt_ref_select(idt, refsel);
+out:
+	mutex_unlock(&idt->chip.lock);
+
+	return ret ? ret : count;
+}
+static DEVICE_ATTR_RW(ref_select);
+
+static struct attribute *idt_attrs[] = {
+	&dev_attr_ref_rates.attr,
+	&dev_attr_ref_select.attr,
+	NULL
+};
+ATTRIBUTE_GROUPS(idt);
+
 static const struct of_device_id idt_of_id_table[] = {
 	{ .compatible = "idt,idt8t49" },
 	{ }
@@ -800,6 +1046,10 @@ static const u8 IDT_8T49N24x_Config_JA[] = {
 	0x00, 0x00, 0x27, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
 };
 
+/* Snapshots cover the configuration written by idt_init() */
+static const struct regmap_range idt_dump =
+	regmap_reg_range(0x0000, sizeof(IDT_8T49N24x_Config_JA) - 1);
+
 static int idt_init(struct idts *idt)
 {
 	u32 Index;
@@ -817,12 +1067,18 @@ static int idt_init(struct idts *idt)
 	return 0;	
 }
 
+/* Unbind: stop idt_clk_set_rate() from using the chip */
+static void idt_release(void *data)
+{
+	idtdata = NULL;
+}
+
 static int idt_probe(struct i2c_client *client)
 {
 	struct idts *data;
 	struct clk_init_data init;
 	u32 initial_fout;
-	int ret, err;
+	int err;
 
 	/* initialize idt */
 	data = devm_kzalloc(&client->dev, sizeof(*data), GFP_KERNEL);
@@ -834,24 +1090,44 @@ static int idt_probe(struct i2c_client *client)
 	init.num_parents = 0;
 	data->hw.init = &init;
 	data->client = client;
-
-	mutex_init(&data->lock);
+	mutex_init(&data->rate_lock);
 
 	if (of_property_read_string(client->dev.of_node, "clock-output-names",
 			&init.name))
-		init.name = client->dev.of_node->name;
+		init.name = client->dev.of_node ? client->dev.of_node->name :
+						  client->name;
+
+	if (of_property_read_u32(client->dev.of_node, "idt,xtal-frequency",
+				 &data->xtal))
+		data->xtal = IDT_8T49N24X_XTAL_FREQ;
+	if (!data->xtal) {
+		dev_err(&client->dev, "invalid crystal frequency\n");
+		return -EINVAL;
+	}
 
 	/* initialize regmap */
 	data->regmap = devm_regmap_init_i2c(client, &idt_regmap_config);
 	if (IS_ERR(data->regmap)) {
 		dev_err(&client->dev,
 			"regmap init failed: %ld\n", PTR_ERR(data->regmap));
-		ret = -ENODEV;
-		goto err_regmap;
+		return -ENODEV;
 	}
 
 	i2c_set_clientdata(client, data);
 
+	err = idt_cache_init(data);
+	if (err)
+		return err;
+
+	data->chip.name = DRIVER_NAME;
+	data->chip.dev = &client->dev;
+	data->chip.regmap = data->regmap;
+	data->chip.dump = &idt_dump;
+	data->chip.num_dump = 1;
+	err = xfmc_chip_register(&data->chip);
+	if (err)
+		return err;
+
 	err = devm_clk_hw_register(&client->dev, &data->hw);
 	if (err) {
 		dev_err(&client->dev, "clock registration failed\n");
@@ -883,11 +1159,13 @@ static int idt_probe(struct i2c_client *client)
 		}
 	}
 
-	return 0;
+	/* Published last, idt_clk_set_rate() only sees a probed chip */
+	err = devm_add_action_or_reset(&client->dev, idt_release, NULL);
+	if (err)
+		return err;
+	idtdata = data;
 
-err_regmap:
-	mutex_destroy(&data->lock);
-	return ret;
+	return 0;
 }
 
 #if (LINUX_VERSION_CODE < KERNEL_VERSION(5, 19, 0))
@@ -906,6 +1184,7 @@ static struct i2c_driver idt_i2c_driver = {
 	.driver = {
 		.name	= DRIVER_NAME,
 		.of_match_table	= idt_of_id_table,
+		.dev_groups	= idt_groups,
 	},
 	.probe		= idt_probe,
 	.remove		= idt_remove,
@@ -0,0 +1,335 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * IDT 8T49N24x synthesizer settings solver
+ *
+ * Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+ *
+ */
+#include "idt_calc.h"
+
+int idt_get_int_divtable(int freq_out, int *divtbl, u8 bypass)
+{
+	int ns1_opts[4] = {1,4,5,6};
+	int index;
+	int ns2_min = 1;
+	int ns2_max = 1;
+	
+	int ns2_tmp;
+	int outdiv_tmp;
+	u32 vco_tmp;
+	int outdiv_min;
+	int outdiv_max;
+	int i;
+	int cnt = 0;
+	int *divtbl_ptr = divtbl;
+	/* ceil(IDT_8T49N24X_fvco_MIN/freq_out) */
+	outdiv_min = (IDT_8T49N24X_FVCO_MIN/freq_out) +
+					(((IDT_8T49N24X_FVCO_MIN % freq_out)==0) ? 0 : 1);
+	/* (int)floor(IDT_8T49N24X_fvco_MAX/freq_out) */
+	outdiv_max = (IDT_8T49N24X_FVCO_MAX/freq_out);
+	
+	if (bypass == true) {
+		index = 0;
+	}
+	else {
+		index = 1;
+	}
+	
+	for (i = index; i < (sizeof(ns1_opts)/sizeof(int)); i++) {
+		/* This is for the case where we want to bypass NS2 */
+		if ((ns1_opts[i] == outdiv_min) || (ns1_opts[i] == outdiv_max)) {
+			ns2_min = 0;
+			ns2_max = 0;
+		}
+	}
+	
+	/* if this test passes, then we know we're not in the bypass case */
+	if (ns2_min == 1) {
+		/* The last element in the list */
+		/* (int)ceil(outdiv_min / ns1_opts[3] / 2) */
+		ns2_min = (outdiv_min / ns1_opts[3] / 2) +
+				((((outdiv_min / ns1_opts[3]) % 2)==0) ? 0 : 1);
+		/* floor(outdiv_max / ns1_opts[index] / 2) */
+		ns2_max = (outdiv_max / ns1_opts[index] / 2);
+		if (ns2_max == 0)
+			/* because we're rounding-down for the max, we may end-up with
+			   it being 0, in which case we need to make it 1 */
+			ns2_max = 1; 
+	}
+	 
+	ns2_tmp = ns2_min;
+	
+	while (ns2_tmp <= ns2_max) {
+		for (i = index; i < (sizeof(ns1_opts)/sizeof(int)); i++) {
+			if (ns2_tmp == 0) {
+				outdiv_tmp = ns1_opts[i];
+			}
+			else {
+				outdiv_tmp = ns1_opts[i] * ns2_tmp * 2;
+			}
+			
+			vco_tmp = freq_out * outdiv_tmp;
+			
+			if ((vco_tmp <= IDT_8T49N24X_FVCO_MAX) &&
+			    (vco_tmp >= IDT_8T49N24X_FVCO_MIN)) {
+				*divtbl_ptr = outdiv_tmp;
+				cnt++;
+				divtbl_ptr++;
+			}
+		}
+		ns2_tmp++;
+	}
+	
+	return cnt;
+}
+
+int idt_cal_settings(u32 xtal, int freq_in, int freq_out,
+		     struct idt_settings *settings)
+{
+	int divtbl[20];
+	int divtbl_cnt;
+	int max_div = 0;
+	unsigned int fvco;
+	int ns1;
+	int ns2;
+	int ns1_ratio;
+	int ns2_ratio;
+	unsigned int UpperFBDiv, UpperFBDiv_rem;
+	int dsm_int;
+	u64 dsm_frac;
+	int los;
+	int i;
+	u32 n_q2 = 0;
+	u32 nfrac_q2 = 0;
+	u64 m1 = 0;
+	int p_min;
+	unsigned int frac_numerator;
+	int m1_default;
+	int p_default;
+	int error_tmp = 999999;
+	int error = 99999999;
+
+	int count = 0;
+
+	/* Get the valid integer dividers */
+	divtbl_cnt = idt_get_int_divtable(freq_out, divtbl, false);
+	
+	/* Find the highest divider */
+	for (i = 0; i < divtbl_cnt; i++) {
+		if (max_div < divtbl[i]) {
+			max_div = divtbl[i];
+		}
+	}
+	fvco = freq_out*max_div;
+	
+	/***************************************************/
+	/* INTEGER DIVIDER: Determine NS1 register setting */
+	/***************************************************/
+#if 0	
+	/* Only use the divide-by-1 option for really small divide ratios
+	 * note that this option will never be on the list for the
+	 * Q0 - Q3 dividers
+	 */
+	if (max_div < 4) { 
+		
+	}
+#endif	
+	/* Make sure we can divide the ratio by 4 in NS1 and by 1 or an
+	 * even number in NS2
+	 */
+	if ((max_div == 4) ||
+	    (max_div % 8 == 0)) { 
+		/* Divide by 4 register selection */
+		ns1 = 2;
+	}
+	
+	/* Make sure we can divide the ratio by 5 in NS1 and by 1 or
+	 * an even number in NS2
+	 */
+	if ((max_div == 5) ||
+	    (max_div % 10 == 0)) {
+		/* Divide by 5 register selection */
+		ns1 = 0;
+	}
+	
+	/* Make sure we can divide the ratio by 6 in NS1 and by 1 or
+	 * an even number in NS2
+	 */
+	if ((max_div == 6) ||
+	    (max_div % 12 == 0)) {
+		/* Divide by 6 register setting */
+		ns1 = 1;
+	}
+	
+	/***************************************************/
+	/* INTEGER DIVIDER: Determine NS2 register setting */
+	/***************************************************/
+	
+	switch (ns1) {
+		case (0) :
+			ns1_ratio = 5;
+		break;
+		
+		case (1) :
+			ns1_ratio = 6;
+		break;
+		
+		case (2) :
+			ns1_ratio = 4;
+		break;
+		
+		case (3) :
+			/* This is the bypass (divide-by-1) option */
+			ns1_ratio = 1;
+		break;
+		
+		default :
+			ns1_ratio = 6;
+		break;
+	}
+	
+	/* floor(max_div / ns1_ratio) */
+	ns2_ratio = (max_div / ns1_ratio);
+	
+	/* floor(ns2_ratio/2) */
+	ns2 = (ns2_ratio/2);
+	
+	if (max_div & 1)
+	{
+		frac_numerator = (268435456 >> 1);
+	}
+	else
+	{
+		frac_numerator = 0;
+	}
+	/* This is the case where the fractional portion is 0.
+	 * Due to precision limitations, sometimes fractional portion of the
+	 * Effective divider gets rounded to 1.  This checks for that condition
+	 */
+	if (!(max_div & 1))
+	{
+		/* n_q2 = (int)round(FracDiv / 2.0); */
+		n_q2 = max_div >> 1;
+		nfrac_q2 = 0;
+	}
+	else
+	{
+		/* n_q2 = (int)floor(FracDiv / 2.0); */
+		n_q2 = ((max_div+1)>>1);
+		nfrac_q2 = frac_numerator;
+	}
+
+	/*****************************************************/
+	/* Calculate the Upper Loop Feedback divider setting */
+	/*****************************************************/
+	
+	UpperFBDiv = (fvco) / (2*xtal);
+	UpperFBDiv_rem = fvco % (2 * xtal);
+
+	/* dsm_int = (int)floor(UpperFBDiv); */
+	dsm_int = (int)(UpperFBDiv);
+	
+	/*dsm_frac =
+	 * 			(int)round((UpperFBDiv - floor(UpperFBDiv))*pow(2,21));
+	 */
+	//dsm_frac = (int)(((UpperFBDiv - (int)UpperFBDiv)*2097152) + 1/2);
+	dsm_frac = ((u64)UpperFBDiv_rem << 21) + xtal;
+	dsm_frac = div_u64(dsm_frac, 2 * xtal);
+	
+	/*****************************************************/
+	/* Calculate the Lower Loop Feedback divider and
+	 * input Divider
+	 *****************************************************/
+	
+//	Ratio = fvco/freq_in;
+	
+	p_min = (int)freq_in/IDT_8T49N24X_FPD_MAX;
+	
+	/* This m1 divider sets the input PFD frequency at 128KHz, the set max */
+	/* int M1Min = (int)(fvco/IDT_8T49N24X_FPD_MAX); */
+
+
+	/* Start from lowest divider and iterate until 0 error is found
+	 * or the divider limit is exhausted.
+	 */
+	/* Keep the setting with the lowest error */
+	for (i = p_min; i <= IDT_8T49N24X_P_MAX; i++) {
+		/* m1 = (int)round(i*Ratio); */
+//		m1 = (int)(i*Ratio +  1/2);
+		m1 = (u64)fvco *i;
+		m1 += (freq_in >> 1);
+		m1 /= freq_in;
+		count++;
+		if (m1 < IDT_8T49N24X_M_MAX) {
+			u64 temp = ((u64)fvco*i - (u64)m1*freq_in)*1000000;
+			u64 temp1 = (u64)i*freq_in/1000;
+			temp = temp / temp1;
+			error_tmp = (int)temp;
+//			error_tmp = (int)(Ratio*1000000000 - (m1*1000000000 / i));
+
+			if (abs(error_tmp) < error || error_tmp == 0) {
+				error = abs(error_tmp);
+				m1_default = m1;
+				p_default = i;
+
+				if (error_tmp == 0)
+					break;
+			}
+		}
+		else {
+			break;
+		}
+	}
+	
+	/* Calculate los */
+	los = fvco / 8 / freq_in; 
+	los = los + 3;
+	if (los < 6)
+		los = 6;
+
+	/* Copy registers */
+	settings->ns1_qx = ns1;
+	settings->ns2_qx = ns2;
+	
+	settings->n_qx = n_q2;
+	settings->nfrac_qx = nfrac_q2;
+
+	settings->dsm_int = dsm_int;
+	settings->dsm_frac = dsm_frac;
+	settings->m1_x = m1_default;
+	settings->pre_x = p_default;
+	settings->los_x = los;
+
+	return 0;
+}
+
+static unsigned int idt_bytes_changed(u32 old, u32 new, unsigned int num)
+{
+	unsigned int i, n = 0;
+
+	for (i = 0; i < num; i++)
+		if (((old >> (8 * i)) & 0xff) != ((new >> (8 * i)) & 0xff))
+			n++;
+
+	return n;
+}
+
+/*
+ * Divider register bytes that differ between the settings of both inputs,
+ * output dividers counted for both outputs 2 and 3.
+ */
+unsigned int idt_settings_delta(const struct idt_settings *old,
+				const struct idt_settings *new)
+{
+	unsigned int i, n = 0;
+
+	for (i = 0; i < 2; i++)
+		n += idt_bytes_changed(old[i].pre_x, new[i].pre_x, 3) +
+		     idt_bytes_changed(old[i].m1_x, new[i].m1_x, 3) +
+		     idt_bytes_changed(old[i].los_x, new[i].los_x, 3);
+
+	return n + idt_bytes_changed(old->dsm_int, new->dsm_int, 2) +
+	       idt_bytes_changed(old->dsm_frac, new->dsm_frac, 3) +
+	       2 * idt_bytes_changed(old->n_qx, new->n_qx, 3) +
+	       2 * idt_bytes_changed(old->nfrac_qx, new->nfrac_qx, 4);
+}
@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * IDT 8T49N24x synthesizer settings solver
+ *
+ * Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Divider computation of the idt driver, without I/O so that it also
+ * builds in userspace, see xfmc_types.h.
+ */
+#ifndef __IDT_CALC_H__
+#define __IDT_CALC_H__
+
+#include "xfmc_types.h"
+
+#define IDT_8T49N24X_FVCO_MAX 4000000000 //!< Max VCO Operating Freq in Hz
+#define IDT_8T49N24X_FVCO_MIN 3000000000 //!< Min VCO Operating Freq in Hz
+#define IDT_8T49N24X_FOUT_MAX 400000000  //!< Max Output Freq in Hz
+#define IDT_8T49N24X_FOUT_MIN      8000  //!< Min Output Freq in Hz
+#define IDT_8T49N24X_FIN_MAX 875000000   //!< Max input Freq in Hz
+#define IDT_8T49N24X_FIN_MIN      8000   //!< Min input Freq in Hz
+#define IDT_8T49N24X_FPD_MAX 128000      //!< Max Phase Detector Freq in Hz
+#define IDT_8T49N24X_FPD_MIN   8000      //!< Min Phase Detector Freq in Hz
+#define IDT_8T49N24X_P_MAX 4194304  /* pow(2,22) */  //!< Max P div value
+#define IDT_8T49N24X_M_MAX 16777216 /* pow(2,24) */  //!< Max M mult value
+
+struct idt_settings {
+	u32 dsm_frac;
+	u32 m1_x;
+	u32 pre_x;
+	u32 los_x;
+	u32 n_qx;
+	u32 nfrac_qx;
+	u16 ns2_qx;
+	u16 dsm_int;
+	u8  ns1_qx;
+	
+};
+
+int idt_get_int_divtable(int freq_out, int *divtbl, u8 bypass);
+int idt_cal_settings(u32 xtal, int freq_in, int freq_out,
+		     struct idt_settings *settings);
+unsigned int idt_settings_delta(const struct idt_settings *old,
+				const struct idt_settings *new);
+
+#endif /* __IDT_CALC_H__ */
@@ -18,11 +18,14 @@
 #include <linux/slab.h>
 #include <linux/version.h>
 
+#include "xfmc.h"
+
 #define DRIVER_NAME "onsemi-rx"
 
 void onsemirx_exit(void);
 int onsemirx_entry(void);
-int onsemirx_linerate_conf(u8 is_frl, u64 LineRate, u8 is_tx);
+int onsemirx_linerate_conf(u8 is_frl, u64 LineRate, u8 is_tx,
+			   struct xfmc_request *req);
 
 #define to_onsemirx(_hw)	container_of(_hw, struct onsemirx, hw)
 struct onsemirx *os_rxdata;
@@ -64,11 +67,7 @@ typedef enum {
 	RX_R3_FRL = RX_R3_TMDS_20 + 21,
 } Onsemi_DeviceType;
 
-typedef struct {
-	u16 dev_type;
-	u8 Address;
-	u8 Values;
-} Onsemi_RegisterField;
+typedef struct reg_fields Onsemi_RegisterField;
 
 /*
  * This table contains the values to be programmed to ONSEMI device.
@@ -585,6 +584,39 @@ const Onsemi_RegisterField onsemirx_regs[] = {
 
 };
 
+static const struct xfmc_profile onsemirx_profiles[] = {
+	{ TX_R0_TMDS, "TX_R0_TMDS" },
+	{ TX_R0_TMDS_14_L, "TX_R0_TMDS_14_L" },
+	{ TX_R0_TMDS_14_H, "TX_R0_TMDS_14_H" },
+	{ TX_R0_TMDS_20, "TX_R0_TMDS_20" },
+	{ TX_R0_FRL, "TX_R0_FRL" },
+	{ RX_R0, "RX_R0" },
+	{ TX_R1_TMDS_14_LL, "TX_R1_TMDS_14_LL" },
+	{ TX_R1_TMDS_14_L, "TX_R1_TMDS_14_L" },
+	{ TX_R1_TMDS_14, "TX_R1_TMDS_14" },
+	{ TX_R1_TMDS_20, "TX_R1_TMDS_20" },
+	{ TX_R1_FRL, "TX_R1_FRL" },
+	{ TX_R1_FRL_10G, "TX_R1_FRL_10G" },
+	{ TX_R1_FRL_12G, "TX_R1_FRL_12G" },
+	{ RX_R1_TMDS_14, "RX_R1_TMDS_14" },
+	{ RX_R1_TMDS_20, "RX_R1_TMDS_20" },
+	{ RX_R1_FRL, "RX_R1_FRL" },
+	{ TX_R2_TMDS_14_L, "TX_R2_TMDS_14_L" },
+	{ TX_R2_TMDS_14_H, "TX_R2_TMDS_14_H" },
+	{ TX_R2_TMDS_20, "TX_R2_TMDS_20" },
+	{ TX_R2_FRL, "TX_R2_FRL" },
+	{ RX_R2_TMDS_14, "RX_R2_TMDS_14" },
+	{ RX_R2_TMDS_20, "RX_R2_TMDS_20" },
+	{ RX_R2_FRL, "RX_R2_FRL" },
+	{ TX_R3_TMDS_14_L, "TX_R3_TMDS_14_L" },
+	{ TX_R3_TMDS_14_H, "TX_R3_TMDS_14_H" },
+	{ TX_R3_TMDS_20, "TX_R3_TMDS_20" },
+	{ TX_R3_FRL, "TX_R3_FRL" },
+	{ RX_R3_TMDS_14, "RX_R3_TMDS_14" },
+	{ RX_R3_TMDS_20, "RX_R3_TMDS_20" },
+	{ RX_R3_FRL, "RX_R3_FRL" },
+};
+
 static const struct regmap_config onsemirx_regmap_config = {
 	.reg_bits = 8,
 	.val_bits = 8,
@@ -598,6 +630,7 @@ static const struct regmap_config onsemirx_regmap_config = {
  * @regmap: Pointer to regmap structure
  * @lock: Mutex structure
  * @mode_index: Resolution mode index
+ * @chip: FMC core chip, tracks the applied profile
  */
 struct onsemirx {
 	struct clk_hw hw;
@@ -605,6 +638,7 @@ struct onsemirx {
 	struct regmap *regmap;
 	struct mutex lock; /* mutex lock for operations */
 	u32 mode_index;
+	struct xfmc_chip chip;
 };
 
 static inline int onsemirx_read_reg(struct onsemirx *priv, u8 addr, u8 *val)
@@ -631,15 +665,21 @@ static inline int onsemirx_write_reg(struct onsemirx *priv, u8 addr, u8 val)
 	return err;
 }
 
-int onsemirx_linerate_conf(u8 is_frl, u64 LineRate, u8 is_tx)
+int onsemirx_linerate_conf(u8 is_frl, u64 LineRate, u8 is_tx,
+			   struct xfmc_request *req)
 {
-	u32 linerate_mbps;
-	u32 i = 0;
+	u32 linerate_mbps, measured;
 	u16 dev_type = 0xffff;
-	int ret = 1;
+	int ret;
 	u8 revision = 3; //onsemi tx-mezz- R3
 
-	linerate_mbps = (u32)((u64) LineRate / 100000); //remove one zero
+	if (!os_rxdata)
+		return -ENODEV;
+
+	measured = (u32)((u64) LineRate / 100000); //remove one zero
+	linerate_mbps = measured;
+	if (!is_frl)
+		linerate_mbps = xfmc_tmds_rate(&os_rxdata->chip, measured, req);
 	printk("linerate %llu lineratembps %u \n\r",LineRate,linerate_mbps);
 	/* TX */
 	if (is_tx == 1) {
@@ -784,16 +824,15 @@ int onsemirx_linerate_conf(u8 is_frl, u64 LineRate, u8 is_tx)
 		}
 	}
 
-	i = dev_type;
-	while (dev_type == onsemirx_regs[i].dev_type) {
-		ret = onsemirx_write_reg(os_rxdata, onsemirx_regs[i].Address,
-				       onsemirx_regs[i].Values);
-		if (ret) {
-			return ret;
-		}
+	ret = xfmc_chip_apply_req(&os_rxdata->chip, dev_type, req);
+	if (ret)
+		return ret;
+	if (!is_frl)
+		xfmc_tmds_commit(&os_rxdata->chip, measured, linerate_mbps,
+				 req);
 
-		i++;
-	}
+	dev_dbg(os_rxdata->chip.dev, "%s profile %s\n", is_tx ? "tx" : "rx",
+		xfmc_profile_name(&os_rxdata->chip, dev_type));
 
 	return ret;
 }
@@ -801,9 +840,7 @@ EXPORT_SYMBOL_GPL(onsemirx_linerate_conf);
 
 static int onsemirx_init(struct onsemirx *priv, u8 revision, u8 is_tx)
 {
-	int ret = 1;
 	u16 dev_type = 0xffff;
-	u32 i = 0;
 
 	if (is_tx == 1) {
 		switch (revision) {
@@ -843,52 +880,60 @@ static int onsemirx_init(struct onsemirx *priv, u8 revision, u8 is_tx)
 		}
 	}
 
-	i = dev_type;
-
-	while (dev_type == onsemirx_regs[i].dev_type) {
-		ret = onsemirx_write_reg(priv, onsemirx_regs[i].Address,
-				       onsemirx_regs[i].Values);
-
-		if (ret) {
-			return ret;
-		}
-
-		i++;
-	}
+	return xfmc_chip_apply(&priv->chip, dev_type);
+}
 
-	return ret;
+/* Unbind: stop the linerate calls from using the chip */
+static void onsemirx_release(void *data)
+{
+	os_rxdata = NULL;
 }
 
 static int onsemirx_probe(struct i2c_client *client)
 {
+	struct onsemirx *data;
 	struct clk_init_data init;
 	int ret, err;
 	u32 initial_fout;
 
 	/* initialize onsemi */
-	os_rxdata = devm_kzalloc(&client->dev, sizeof(*os_rxdata), GFP_KERNEL);
-	if (!os_rxdata)
+	data = devm_kzalloc(&client->dev, sizeof(*data), GFP_KERNEL);
+	if (!data)
 		return -ENOMEM;
 
-	mutex_init(&os_rxdata->lock);
+	data->client = client;
+	mutex_init(&data->lock);
 
 	if (of_property_read_string(client->dev.of_node, "clock-output-names",
 			&init.name))
 		init.name = client->dev.of_node->name;
 
 	/* initialize regmap */
-	os_rxdata->regmap = devm_regmap_init_i2c(client, &onsemirx_regmap_config);
-	if (IS_ERR(os_rxdata->regmap)) {
+	data->regmap = devm_regmap_init_i2c(client, &onsemirx_regmap_config);
+	if (IS_ERR(data->regmap)) {
 		dev_err(&client->dev,
-			"regmap init failed: %ld\n", PTR_ERR(os_rxdata->regmap));
+			"regmap init failed: %ld\n", PTR_ERR(data->regmap));
 		ret = -ENODEV;
 		goto err_regmap;
 	}
 
-	i2c_set_clientdata(client, os_rxdata);
+	i2c_set_clientdata(client, data);
+
+	data->chip.name = DRIVER_NAME;
+	data->chip.dev = &client->dev;
+	data->chip.regmap = data->regmap;
+	data->chip.regs = onsemirx_regs;
+	data->chip.num_regs = ARRAY_SIZE(onsemirx_regs);
+	data->chip.profiles = onsemirx_profiles;
+	data->chip.num_profiles = ARRAY_SIZE(onsemirx_profiles);
+	/* Line rates are in 100 kbps, scale the hysteresis margins */
+	data->chip.tmds_scale = 10;
+	ret = xfmc_chip_register(&data->chip);
+	if (ret)
+		return ret;
 	dev_dbg(&client->dev, "init onsemi-rx with default values \n");
 	/* revision Pass4 Silicon, VFMC Active HDMI TX Mezz (R2) */
-	ret = onsemirx_init(os_rxdata, 3, false);
+	ret = onsemirx_init(data, 3, false);
 	if (ret) {
 		dev_err(&client->dev, "failed to init onsemi-rx \n");
 		return ret;
@@ -897,17 +942,23 @@ static int onsemirx_probe(struct i2c_client *client)
 	/* Read the requested initial output frequency from device tree */
 	if (!of_property_read_u32(client->dev.of_node, "clock-frequency",
 				&initial_fout)) {
-		err = clk_set_rate(os_rxdata->hw.clk, initial_fout);
+		err = clk_set_rate(data->hw.clk, initial_fout);
 		if (err) {
 			of_clk_del_provider(client->dev.of_node);
 			return err;
 		}
 	}
 
+	/* Published last, the linerate calls only see a probed chip */
+	ret = devm_add_action_or_reset(&client->dev, onsemirx_release, NULL);
+	if (ret)
+		return ret;
+	os_rxdata = data;
+
 	return 0;
 
 err_regmap:
-	mutex_destroy(&os_rxdata->lock);
+	mutex_destroy(&data->lock);
 	return ret;
 }
 
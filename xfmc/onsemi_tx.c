@@ -18,7 +18,10 @@
 #include <linux/slab.h>
 #include <linux/version.h>
 
-int onsemitx_linerate_conf(u8 is_frl, u64 linerate, u8 is_tx);
+#include "xfmc.h"
+
+int onsemitx_linerate_conf(u8 is_frl, u64 linerate, u8 is_tx,
+			   struct xfmc_request *req);
 void onsemitx_exit(void);
 int onsemitx_entry(void);
 
@@ -27,12 +30,6 @@ int onsemitx_entry(void);
 #define to_onsemitx(_hw)	container_of(_hw, struct onsemitx, hw)
 struct onsemitx *os_txdata;
 
-struct reg_fields {
-	u16 dev_type;
-	u8 addr;
-	u8 val;
-};
-
 enum {
 	TX_R0_TMDS = 0,
 	TX_R0_TMDS_14_L = 21,
@@ -589,6 +586,39 @@ const struct reg_fields onsemitx_regs[] = {
 
 };
 
+static const struct xfmc_profile onsemitx_profiles[] = {
+	{ TX_R0_TMDS, "TX_R0_TMDS" },
+	{ TX_R0_TMDS_14_L, "TX_R0_TMDS_14_L" },
+	{ TX_R0_TMDS_14_H, "TX_R0_TMDS_14_H" },
+	{ TX_R0_TMDS_20, "TX_R0_TMDS_20" },
+	{ TX_R0_FRL, "TX_R0_FRL" },
+	{ RX_R0, "RX_R0" },
+	{ TX_R1_TMDS_14_LL, "TX_R1_TMDS_14_LL" },
+	{ TX_R1_TMDS_14_L, "TX_R1_TMDS_14_L" },
+	{ TX_R1_TMDS_14, "TX_R1_TMDS_14" },
+	{ TX_R1_TMDS_20, "TX_R1_TMDS_20" },
+	{ TX_R1_FRL, "TX_R1_FRL" },
+	{ TX_R1_FRL_10G, "TX_R1_FRL_10G" },
+	{ TX_R1_FRL_12G, "TX_R1_FRL_12G" },
+	{ RX_R1_TMDS_14, "RX_R1_TMDS_14" },
+	{ RX_R1_TMDS_20, "RX_R1_TMDS_20" },
+	{ RX_R1_FRL, "RX_R1_FRL" },
+	{ TX_R2_TMDS_14_L, "TX_R2_TMDS_14_L" },
+	{ TX_R2_TMDS_14_H, "TX_R2_TMDS_14_H" },
+	{ TX_R2_TMDS_20, "TX_R2_TMDS_20" },
+	{ TX_R2_FRL, "TX_R2_FRL" },
+	{ RX_R2_TMDS_14, "RX_R2_TMDS_14" },
+	{ RX_R2_TMDS_20, "RX_R2_TMDS_20" },
+	{ RX_R2_FRL, "RX_R2_FRL" },
+	{ TX_R3_TMDS_14_L, "TX_R3_TMDS_14_L" },
+	{ TX_R3_TMDS_14_H, "TX_R3_TMDS_14_H" },
+	{ TX_R3_TMDS_20, "TX_R3_TMDS_20" },
+	{ TX_R3_FRL, "TX_R3_FRL" },
+	{ RX_R3_TMDS_14, "RX_R3_TMDS_14" },
+	{ RX_R3_TMDS_20, "RX_R3_TMDS_20" },
+	{ RX_R3_FRL, "RX_R3_FRL" },
+};
+
 static const struct regmap_config onsemitx_regmap_config = {
 	.reg_bits = 8,
 	.val_bits = 8,
@@ -601,6 +631,7 @@ static const struct regmap_config onsemitx_regmap_config = {
  * @regmap: Pointer to regmap structure
  * @lock: Mutex structure
  * @mode_index: Resolution mode index
+ * @chip: FMC core chip, tracks the applied profile
  */
 struct onsemitx {
 	struct clk_hw hw;
@@ -608,6 +639,7 @@ struct onsemitx {
 	struct regmap *regmap;
 	struct mutex lock; /* mutex lock for operations */
 	u32 mode_index;
+	struct xfmc_chip chip;
 };
 
 static inline int onsemitx_read_reg(struct onsemitx *priv, u8 addr, u8 *val)
@@ -634,15 +666,21 @@ static inline int onsemitx_write_reg(struct onsemitx *priv, u8 addr, u8 val)
 	return err;
 }
 
-int onsemitx_linerate_conf(u8 is_frl, u64 linerate, u8 is_tx)
+int onsemitx_linerate_conf(u8 is_frl, u64 linerate, u8 is_tx,
+			   struct xfmc_request *req)
 {
-	u32 linerate_mbps;
-	u32 i = 0;
+	u32 linerate_mbps, measured;
 	u16 dev_type = 0xffff;
-	int ret = 1;
+	int ret;
 	u8 revision = 3; /* onsemi tx-mezz- R3i */
 
-	linerate_mbps = (u32)((u64)linerate / 100000);
+	if (!os_txdata)
+		return -ENODEV;
+
+	measured = (u32)((u64)linerate / 100000);
+	linerate_mbps = measured;
+	if (!is_frl)
+		linerate_mbps = xfmc_tmds_rate(&os_txdata->chip, measured, req);
 	dev_info(&os_txdata->client->dev, "linerate %llu lineratembps %u\n\r",
 		 linerate, linerate_mbps);
 	/* TX */
@@ -768,15 +806,15 @@ int onsemitx_linerate_conf(u8 is_frl, u64 linerate, u8 is_tx)
 		}
 	}
 
-	i = dev_type;
-	while (dev_type == onsemitx_regs[i].dev_type) {
-		ret = onsemitx_write_reg(os_txdata, onsemitx_regs[i].addr,
-				       onsemitx_regs[i].val);
-		if (ret)
-			return ret;
+	ret = xfmc_chip_apply_req(&os_txdata->chip, dev_type, req);
+	if (ret)
+		return ret;
+	if (!is_frl)
+		xfmc_tmds_commit(&os_txdata->chip, measured, linerate_mbps,
+				 req);
 
-		i++;
-	}
+	dev_dbg(os_txdata->chip.dev, "%s profile %s\n", is_tx ? "tx" : "rx",
+		xfmc_profile_name(&os_txdata->chip, dev_type));
 
 	return ret;
 }
@@ -784,9 +822,7 @@ EXPORT_SYMBOL_GPL(onsemitx_linerate_conf);
 
 static int onsemitx_init(struct onsemitx *priv, u8 revision, u8 is_tx)
 {
-	int ret = 1;
 	u16 dev_type = 0xffff;
-	u32 i = 0;
 
 	if (is_tx == 1) {
 		switch (revision) {
@@ -826,56 +862,70 @@ static int onsemitx_init(struct onsemitx *priv, u8 revision, u8 is_tx)
 		}
 	}
 
-	i = dev_type;
-
-	while (dev_type == onsemitx_regs[i].dev_type) {
-		ret = onsemitx_write_reg(priv, onsemitx_regs[i].addr,
-				       onsemitx_regs[i].val);
-
-		if (ret)
-			return ret;
-
-		i++;
-	}
+	return xfmc_chip_apply(&priv->chip, dev_type);
+}
 
-	return ret;
+/* Unbind: stop the linerate calls from using the chip */
+static void onsemitx_release(void *data)
+{
+	os_txdata = NULL;
 }
 
 static int onsemitx_probe(struct i2c_client *client)
 {
+	struct onsemitx *data;
 	int ret;
 
 	/* initialize onsemi */
-	os_txdata = devm_kzalloc(&client->dev, sizeof(*os_txdata), GFP_KERNEL);
-	if (!os_txdata)
+	data = devm_kzalloc(&client->dev, sizeof(*data), GFP_KERNEL);
+	if (!data)
 		return -ENOMEM;
 
-	os_txdata->client = client;
-	mutex_init(&os_txdata->lock);
+	data->client = client;
+	mutex_init(&data->lock);
 
 	/* initialize regmap */
-	os_txdata->regmap = devm_regmap_init_i2c(client, &onsemitx_regmap_config);
-	if (IS_ERR(os_txdata->regmap)) {
+	data->regmap = devm_regmap_init_i2c(client, &onsemitx_regmap_config);
+	if (IS_ERR(data->regmap)) {
 		dev_err(&client->dev,
-			"regmap init failed: %ld\n", PTR_ERR(os_txdata->regmap));
+			"regmap init failed: %ld\n", PTR_ERR(data->regmap));
 		ret = -ENODEV;
 		goto err_regmap;
 	}
 
-	i2c_set_clientdata(client, os_txdata);
+	i2c_set_clientdata(client, data);
+
+	data->chip.name = DRIVER_NAME;
+	data->chip.dev = &client->dev;
+	data->chip.regmap = data->regmap;
+	data->chip.regs = onsemitx_regs;
+	data->chip.num_regs = ARRAY_SIZE(onsemitx_regs);
+	data->chip.profiles = onsemitx_profiles;
+	data->chip.num_profiles = ARRAY_SIZE(onsemitx_profiles);
+	/* Line rates are in 100 kbps, scale the hysteresis margins */
+	data->chip.tmds_scale = 10;
+	ret = xfmc_chip_register(&data->chip);
+	if (ret)
+		return ret;
 
 	dev_dbg(&client->dev, "init onsemi-tx\n");
 	/* revision Pass4 Silicon, VFMC Active HDMI TX Mezz (R2) */
-	ret = onsemitx_init(os_txdata, 3, true);
+	ret = onsemitx_init(data, 3, true);
 	if (ret) {
 		dev_err(&client->dev, "failed to init onsemi-tx\n");
 		return ret;
 	}
 
+	/* Published last, the linerate calls only see a probed chip */
+	ret = devm_add_action_or_reset(&client->dev, onsemitx_release, NULL);
+	if (ret)
+		return ret;
+	os_txdata = data;
+
 	return 0;
 
 err_regmap:
-	mutex_destroy(&os_txdata->lock);
+	mutex_destroy(&data->lock);
 	return ret;
 }
 
@@ -6,9 +6,20 @@
  *
  * This driver configures the SI5344 chip to generate constant 400MHz FRL clock
  * Note: This is not a common clock framwork driver.
+ *
+ * The plan can be burnt into the device NVM so that it comes up with it at
+ * power-up. A burnt plan is tagged with "XFMC" and the CRC32 of the plan in
+ * the design ID registers; probe skips programming when the tag matches.
+ * Burning is a one-way operation with two user banks, so it needs the
+ * nvm_burn module parameter and an explicit request through sysfs:
+ *
+ *   echo burn > /sys/bus/i2c/devices/<dev>/nvm_burn
+ *
+ * The chip is registered with the FMC core for register snapshots only.
  */
 #include <linux/clk.h>
 #include <linux/clk-provider.h>
+#include <linux/crc32.h>
 #include <linux/delay.h>
 #include <linux/gcd.h>
 #include <linux/math64.h>
@@ -23,18 +34,43 @@
 #include <linux/unaligned.h>
 #endif
 
+#include "xfmc.h"
+
 int si5344_entry(void);
 void si5344_exit(void);
 
+static bool nvm_burn;
+module_param(nvm_burn, bool, 0644);
+MODULE_PARM_DESC(nvm_burn, "Allow burning the frequency plan into NVM");
+
 struct clk_si5344 {
 	struct clk_hw hw;
 	struct regmap *regmap;
 	struct i2c_client *i2c_client;
+	struct mutex lock; /* serializes NVM operations */
+	u8 design_id[8];
+	struct xfmc_chip chip;
 };
 
 #define SI5344_PAGE		0x0001
+#define SI5344_DEVICE_REV	0x0005
+#define SI5344_ACTIVE_NVM_BANK	0x00E2
+#define SI5344_NVM_WRITE	0x00E3
+#define SI5344_NVM_READ_BANK	0x00E4
+#define SI5344_DEVICE_READY	0x00FE
+#define SI5344_DESIGN_ID	0x026B
 #define SI5344_REGISTER_MAX	0xBFF
 
+#define SI5344_NVM_WRITE_CMD	0xC7
+#define SI5344_READY		0x0F
+#define SI5344_READY_POLL_US	10000
+#define SI5344_READY_TIMEOUT_US	1000000
+
+/* ACTIVE_NVM_BANK values: factory plan, one or both user banks burnt */
+#define SI5344_NVM_BANK_FACTORY	0x03
+#define SI5344_NVM_BANK_1	0x0F
+#define SI5344_NVM_BANK_2	0x3F
+
 /* Static configuration (to be moved to firmware) */
 struct si5344_reg_default {
 	u16 address;
@@ -562,6 +598,151 @@ static int si5344_send_postamble(struct clk_si5344 *data)
 	return 0;
 }
 
+/* Design ID tag of the plan: "XFMC" followed by its CRC32 */
+static void si5344_design_id(u8 *id)
+{
+	unsigned int i;
+	u32 crc = ~0;
+	u8 buf[3];
+
+	for (i = 0; i < ARRAY_SIZE(si5344_reg_defaults); i++) {
+		put_unaligned_be16(si5344_reg_defaults[i].address, buf);
+		buf[2] = si5344_reg_defaults[i].value;
+		crc = crc32_le(crc, buf, sizeof(buf));
+	}
+
+	memcpy(id, "XFMC", 4);
+	put_unaligned_le32(~crc, id + 4);
+}
+
+static int si5344_wait_ready(struct clk_si5344 *data)
+{
+	unsigned int val;
+	int res;
+
+	res = regmap_read_poll_timeout(data->regmap, SI5344_DEVICE_READY, val,
+				       val == SI5344_READY, SI5344_READY_POLL_US,
+				       SI5344_READY_TIMEOUT_US);
+	if (res)
+		dev_err(&data->i2c_client->dev, "device not ready: %#x\n", val);
+
+	return res;
+}
+
+/* True if the device runs the plan of this driver */
+static bool si5344_plan_loaded(struct clk_si5344 *data)
+{
+	u8 id[8];
+
+	if (si5344_wait_ready(data))
+		return false;
+
+	if (regmap_bulk_read(data->regmap, SI5344_DESIGN_ID, id, sizeof(id)))
+		return false;
+
+	return !memcmp(id, data->design_id, sizeof(id));
+}
+
+/*
+ * Burn the registers into the next free NVM bank and load it back. The
+ * plan must be in the device registers, which is the case after probe.
+ */
+static int si5344_nvm_burn(struct clk_si5344 *data)
+{
+	struct device *dev = &data->i2c_client->dev;
+	unsigned int bank;
+	int res;
+
+	res = regmap_read(data->regmap, SI5344_ACTIVE_NVM_BANK, &bank);
+	if (res)
+		return res;
+
+	if (bank != SI5344_NVM_BANK_FACTORY && bank != SI5344_NVM_BANK_1) {
+		dev_err(dev, "no free NVM bank: %#x\n", bank);
+		return -ENOSPC;
+	}
+
+	if (si5344_plan_loaded(data)) {
+		dev_info(dev, "plan already in NVM\n");
+		return -EALREADY;
+	}
+
+	res = regmap_bulk_write(data->regmap, SI5344_DESIGN_ID,
+				data->design_id, sizeof(data->design_id));
+	if (res)
+		return res;
+
+	dev_info(dev, "burning plan into NVM, bank %#x\n", bank);
+	res = regmap_write(data->regmap, SI5344_NVM_WRITE,
+			   SI5344_NVM_WRITE_CMD);
+	if (res)
+		return res;
+
+	res = si5344_wait_ready(data);
+	if (res)
+		return res;
+
+	res = regmap_write(data->regmap, SI5344_NVM_READ_BANK, 0x01);
+	if (res)
+		return res;
+
+	res = si5344_wait_ready(data);
+	if (res)
+		return res;
+
+	if (!si5344_plan_loaded(data)) {
+		dev_err(dev, "NVM read back mismatch\n");
+		return -EIO;
+	}
+
+	return 0;
+}
+
+static ssize_t nvm_burn_store(struct device *dev,
+			      struct device_attribute *attr,
+			      const char *buf, size_t count)
+{
+	struct clk_si5344 *data = dev_get_drvdata(dev);
+	int res;
+
+	if (!nvm_burn)
+		return -EPERM;
+
+	if (!sysfs_streq(buf, "burn"))
+		return -EINVAL;
+
+	mutex_lock(&data->lock);
+	res = si5344_nvm_burn(data);
+	mutex_unlock(&data->lock);
+
+	return res ? res : count;
+}
+static DEVICE_ATTR_WO(nvm_burn);
+
+static ssize_t nvm_bank_show(struct device *dev,
+			     struct device_attribute *attr, char *buf)
+{
+	struct clk_si5344 *data = dev_get_drvdata(dev);
+	unsigned int bank;
+	int res;
+
+	mutex_lock(&data->lock);
+	res = regmap_read(data->regmap, SI5344_ACTIVE_NVM_BANK, &bank);
+	mutex_unlock(&data->lock);
+	if (res)
+		return res;
+
+	return sprintf(buf, "%#x\n", bank);
+}
+static DEVICE_ATTR_RO(nvm_bank);
+
+static struct attribute *si5344_attrs[] = {
+	&dev_attr_nvm_burn.attr,
+	&dev_attr_nvm_bank.attr,
+	NULL
+};
+ATTRIBUTE_GROUPS(si5344);
+
 /* Pages 0, 1, 2, 3, 9, A, B are valid, so there are 12 pages */
 static const struct regmap_range_cfg si5344_regmap_ranges[] = {
 	{
@@ -575,6 +756,12 @@ static const struct regmap_range_cfg si5344_regmap_ranges[] = {
 	},
 };
 
+/* Snapshot the valid pages */
+static const struct regmap_range si5344_dump_ranges[] = {
+	regmap_reg_range(0x000, 0x3FF),
+	regmap_reg_range(0x900, SI5344_REGISTER_MAX),
+};
+
 static const struct regmap_config si5344_regmap_config = {
 	.reg_bits = 8,
 	.val_bits = 8,
@@ -584,9 +771,17 @@ static const struct regmap_config si5344_regmap_config = {
 	.max_register = SI5344_REGISTER_MAX,
 };
 
+static void si5344_lock_release(void *data)
+{
+	struct mutex *lock = data;
+
+	mutex_destroy(lock);
+}
+
 static int si5344_probe(struct i2c_client *client)
 {
 	struct clk_si5344 *data;
+	unsigned int rev;
 	int err;
 
 	data = devm_kzalloc(&client->dev, sizeof(*data), GFP_KERNEL);
@@ -594,6 +789,13 @@ static int si5344_probe(struct i2c_client *client)
 		return -ENOMEM;
 
 	data->i2c_client = client;
+	mutex_init(&data->lock);
+	/* Registered first, so destroyed after everything using the lock */
+	err = devm_add_action_or_reset(&client->dev, si5344_lock_release,
+				       &data->lock);
+	if (err)
+		return err;
+	si5344_design_id(data->design_id);
 
 	data->regmap = devm_regmap_init_i2c(client, &si5344_regmap_config);
 	if (IS_ERR(data->regmap))
@@ -601,6 +803,23 @@ static int si5344_probe(struct i2c_client *client)
 
 	i2c_set_clientdata(client, data);
 
+	data->chip.name = "si5344";
+	data->chip.dev = &client->dev;
+	data->chip.regmap = data->regmap;
+	data->chip.dump = si5344_dump_ranges;
+	data->chip.num_dump = ARRAY_SIZE(si5344_dump_ranges);
+	if (regmap_read(data->regmap, SI5344_DEVICE_REV, &rev) == 0)
+		data->chip.revision = rev;
+	err = xfmc_chip_register(&data->chip);
+	if (err)
+		return err;
+
+	/* The device loaded our plan from NVM at power-up */
+	if (si5344_plan_loaded(data)) {
+		dev_info(&client->dev, "plan loaded from NVM\n");
+		return 0;
+	}
+
 	err = si5344_send_preamble(data);
 	if (err < 0) {
 		dev_err(&data->i2c_client->dev, "failed to write pre-amble\n");
@@ -642,6 +861,7 @@ static struct i2c_driver si5344_driver = {
 	.driver = {
 		.name = "si5344",
 		.of_match_table = clk_si5344_of_match,
+		.dev_groups = si5344_groups,
 	},
 	.probe		= si5344_probe,
 	.id_table	= si5344_id,
@@ -18,7 +18,10 @@
 #include <linux/slab.h>
 #include <linux/version.h>
 
-int ti_tmds1204rx_linerate_conf(u8 is_frl, u64 linerate, u8 is_tx, u8 lanes);
+#include "xfmc.h"
+
+int ti_tmds1204rx_linerate_conf(u8 is_frl, u64 linerate, u8 is_tx, u8 lanes,
+				struct xfmc_request *req);
 void ti_tmds1204rx_exit(void);
 int ti_tmds1204rx_entry(void);
 
@@ -27,12 +30,6 @@ int ti_tmds1204rx_entry(void);
 #define to_ti_tmds1204rx(_hw)	container_of(_hw, struct ti_tmds1204rx, hw)
 struct ti_tmds1204rx *rxdata;
 
-struct reg_fields {
-	u16 dev_type;
-	u8 addr;
-	u8 val;
-};
-
 enum {
 	TX_TI_R1_INIT = 0, // program 6 registers
 	TX_TI_TMDS_14_L_R1 = TX_TI_R1_INIT + 7, // 13 registers are programmed
@@ -389,6 +386,57 @@ const struct reg_fields ti_tmds1204rx_regs[] = {
 	{RX_TI_FRL_12G_R1, 0x31, 0x06},
 };
 
+/*
+ * Datapath mode, reg 0x0A[7:6]. RX FRL profiles are retimed, TMDS runs on
+ * the linear redriver path.
+ */
+static const struct xfmc_mode ti_tmds1204rx_retimer = {
+	"retimer", 0x0A, 0xC0, 0x00
+};
+static const struct xfmc_mode ti_tmds1204rx_linear = {
+	"linear", 0x0A, 0xC0, 0x40
+};
+
+static const struct xfmc_profile ti_tmds1204rx_profiles[] = {
+	{ RX_TI_R1_INIT, "RX_TI_R1_INIT", &ti_tmds1204rx_linear },
+	{ RX_TI_TMDS_14_L_R1, "RX_TI_TMDS_14_L_R1", &ti_tmds1204rx_linear },
+	{ RX_TI_TMDS_14_H_R1, "RX_TI_TMDS_14_H_R1", &ti_tmds1204rx_linear },
+	{ RX_TI_TMDS_20_R1, "RX_TI_TMDS_20_R1", &ti_tmds1204rx_linear },
+	{ RX_TI_FRL_3G_R1, "RX_TI_FRL_3G_R1", &ti_tmds1204rx_retimer },
+	{ RX_TI_FRL_6G_3_R1, "RX_TI_FRL_6G_3_R1", &ti_tmds1204rx_retimer },
+	{ RX_TI_FRL_6G_4_R1, "RX_TI_FRL_6G_4_R1", &ti_tmds1204rx_retimer },
+	{ RX_TI_FRL_8G_R1, "RX_TI_FRL_8G_R1", &ti_tmds1204rx_retimer },
+	{ RX_TI_FRL_10G_R1, "RX_TI_FRL_10G_R1", &ti_tmds1204rx_retimer },
+	{ RX_TI_FRL_12G_R1, "RX_TI_FRL_12G_R1", &ti_tmds1204rx_retimer },
+};
+
+/* Profile of each line rate class, RX then TX, revision 1 */
+static const u16 ti_tmds1204rx_rate_profiles[2][XFMC_RATE_NUM] = {
+	{
+		[XFMC_RATE_NONE] = XFMC_PROFILE_NONE,
+		[XFMC_RATE_TMDS_14_L] = RX_TI_TMDS_14_L_R1,
+		[XFMC_RATE_TMDS_14_H] = RX_TI_TMDS_14_H_R1,
+		[XFMC_RATE_TMDS_20] = RX_TI_TMDS_20_R1,
+		[XFMC_RATE_FRL_3G] = RX_TI_FRL_3G_R1,
+		[XFMC_RATE_FRL_6G_3] = RX_TI_FRL_6G_3_R1,
+		[XFMC_RATE_FRL_6G_4] = RX_TI_FRL_6G_4_R1,
+		[XFMC_RATE_FRL_8G] = RX_TI_FRL_8G_R1,
+		[XFMC_RATE_FRL_10G] = RX_TI_FRL_10G_R1,
+		[XFMC_RATE_FRL_12G] = RX_TI_FRL_12G_R1,
+	}, {
+		[XFMC_RATE_NONE] = XFMC_PROFILE_NONE,
+		[XFMC_RATE_TMDS_14_L] = TX_TI_TMDS_14_L_R1,
+		[XFMC_RATE_TMDS_14_H] = TX_TI_TMDS_14_H_R1,
+		[XFMC_RATE_TMDS_20] = TX_TI_TMDS_20_R1,
+		[XFMC_RATE_FRL_3G] = TX_TI_FRL_3G_R1,
+		[XFMC_RATE_FRL_6G_3] = TX_TI_FRL_6G_4_R1,
+		[XFMC_RATE_FRL_6G_4] = TX_TI_FRL_6G_4_R1,
+		[XFMC_RATE_FRL_8G] = TX_TI_FRL_8G_R1,
+		[XFMC_RATE_FRL_10G] = TX_TI_FRL_10G_R1,
+		[XFMC_RATE_FRL_12G] = TX_TI_FRL_12G_R1,
+	},
+};
+
 static const struct regmap_config ti_tmds1204rx_regmap_config = {
 	.reg_bits = 8,
 	.val_bits = 8,
@@ -401,6 +449,7 @@ static const struct regmap_config ti_tmds1204rx_regmap_config = {
  * @regmap: Pointer to regmap structure
  * @lock: Mutex structure
  * @mode_index: Resolution mode index
+ * @chip: FMC core chip, tracks the applied profile
  */
 struct ti_tmds1204rx {
 	struct clk_hw hw;
@@ -408,6 +457,7 @@ struct ti_tmds1204rx {
 	struct regmap *regmap;
 	struct mutex lock; /* mutex lock for operations */
 	u32 mode_index;
+	struct xfmc_chip chip;
 };
 
 static inline int ti_tmds1204rx_read_reg(struct ti_tmds1204rx *priv, u8 addr, u8 *val)
@@ -434,83 +484,47 @@ static inline int ti_tmds1204rx_write_reg(struct ti_tmds1204rx *priv, u8 addr, u
 	return err;
 }
 
-int ti_tmds1204rx_linerate_conf(u8 is_frl, u64 linerate, u8 is_tx, u8 lanes)
+int ti_tmds1204rx_linerate_conf(u8 is_frl, u64 linerate, u8 is_tx, u8 lanes,
+				struct xfmc_request *req)
 {
-	u32 linerate_mbps;
-	u32 i = 0;
-	u16 dev_type = 0xffff;
-	int ret = 1;
+	u32 linerate_mbps, measured;
+	u16 dev_type = XFMC_PROFILE_NONE;
+	int ret;
 	u8 revision = 1;
 
-	linerate_mbps = (u32)((u64)linerate / 1000000);
+	if (!rxdata)
+		return -ENODEV;
+
+	measured = (u32)((u64)linerate / 1000000);
+	linerate_mbps = measured;
+	if (!is_frl)
+		linerate_mbps = xfmc_tmds_rate(&rxdata->chip, measured, req);
 	dev_info(&rxdata->client->dev, "linerate %llu lineratembps %u lanes %d\n\r",
 		 linerate, linerate_mbps, lanes);
-	/* TX */
-	if (is_tx == 1) {
-		switch (revision) {
-		case 1:
-			if (is_frl == 1) {
-				if (linerate_mbps == 12000)
-					dev_type = TX_TI_FRL_12G_R1;
-				else if (linerate_mbps == 10000)
-					dev_type = TX_TI_FRL_10G_R1;
-				else if (linerate_mbps == 8000)
-					dev_type = TX_TI_FRL_8G_R1;
-				else if (linerate_mbps == 6000)
-					dev_type = TX_TI_FRL_6G_4_R1;
-				else if (linerate_mbps == 3000)
-					dev_type = TX_TI_FRL_3G_R1;
-			} else {
-				if (linerate_mbps <= 1650)
-					dev_type = TX_TI_TMDS_14_L_R1;
-				else if (linerate_mbps > 1650 &&
-					 linerate_mbps <= 3400)
-					dev_type = TX_TI_TMDS_14_H_R1;
-				else
-					dev_type = TX_TI_TMDS_20_R1;
-			}
-			break;
-		default:
-			break;
-		}
-	} else { /* RX */
-		switch (revision) {
-		case 1:
-			if (is_frl == 1) {
-				if (linerate_mbps == 12000) {
-					dev_type = RX_TI_FRL_12G_R1;
-				} else if (linerate_mbps == 10000) {
-					dev_type = RX_TI_FRL_10G_R1;
-				} else if (linerate_mbps == 8000) {
-					dev_type = RX_TI_FRL_8G_R1;
-				} else if (linerate_mbps == 6000) {
-					if (lanes == 4) {
-						dev_type = RX_TI_FRL_6G_4_R1;
-					} else {
-						dev_type = RX_TI_FRL_6G_3_R1;
-					}
-				} else if (linerate_mbps == 3000) {
-					dev_type = RX_TI_FRL_3G_R1;
-				}
-			} else {
-				dev_type = RX_TI_TMDS_20_R1;
-			}
-			break;
-		default:
+	switch (revision) {
+	case 1:
+		dev_type = ti_tmds1204rx_rate_profiles[is_tx == 1]
+			[xfmc_rate_classify(is_frl, linerate_mbps, lanes)];
+		break;
+	default:
+		break;
+	}
 
-			break;
-		}
+	if (dev_type == XFMC_PROFILE_NONE) {
+		dev_err(&rxdata->client->dev, "no profile for linerate %u Mbps\n",
+			linerate_mbps);
+		return -EINVAL;
 	}
 
-	i = dev_type;
-	while (dev_type == ti_tmds1204rx_regs[i].dev_type) {
-		ret = ti_tmds1204rx_write_reg(rxdata, ti_tmds1204rx_regs[i].addr,
-				       ti_tmds1204rx_regs[i].val);
-		if (ret)
-			return ret;
+	ret = xfmc_chip_apply_req(&rxdata->chip, dev_type, req);
+	if (ret)
+		return ret;
+	if (!is_frl)
+		xfmc_tmds_commit(&rxdata->chip, measured, linerate_mbps,
+				 req);
 
-		i++;
-	}
+	dev_dbg(&rxdata->client->dev, "%s profile %s\n", is_tx ? "tx" : "rx",
+		xfmc_profile_name(&rxdata->chip, dev_type));
 
 	return ret;
 }
@@ -518,9 +532,7 @@ EXPORT_SYMBOL_GPL(ti_tmds1204rx_linerate_conf);
 
 static int ti_tmds1204rx_init(struct ti_tmds1204rx *priv, u8 revision, u8 is_tx)
 {
-	int ret = 1;
 	u16 dev_type = 0xffff;
-	u32 i = 0;
 
 	if (is_tx == 1) {
 		switch (revision) {
@@ -541,54 +553,67 @@ static int ti_tmds1204rx_init(struct ti_tmds1204rx *priv, u8 revision, u8 is_tx)
 		}
 	}
 
-	i = dev_type;
-
-	while (dev_type == ti_tmds1204rx_regs[i].dev_type) {
-		ret = ti_tmds1204rx_write_reg(priv, ti_tmds1204rx_regs[i].addr,
-				       ti_tmds1204rx_regs[i].val);
-
-		if (ret)
-			return ret;
-
-		i++;
-	}
+	return xfmc_chip_apply(&priv->chip, dev_type);
+}
 
-	return ret;
+/* Unbind: stop the linerate calls from using the chip */
+static void ti_tmds1204rx_release(void *data)
+{
+	rxdata = NULL;
 }
 
 static int ti_tmds1204rx_probe(struct i2c_client *client)
 {
+	struct ti_tmds1204rx *data;
 	int ret;
 
 	/* initialize ti_tmds1204 */
-	rxdata = devm_kzalloc(&client->dev, sizeof(*rxdata), GFP_KERNEL);
-	if (!rxdata)
+	data = devm_kzalloc(&client->dev, sizeof(*data), GFP_KERNEL);
+	if (!data)
 		return -ENOMEM;
 
-	rxdata->client = client;
-	mutex_init(&rxdata->lock);
+	data->client = client;
+	mutex_init(&data->lock);
 
 	/* initialize regmap */
-	rxdata->regmap = devm_regmap_init_i2c(client, &ti_tmds1204rx_regmap_config);
-	if (IS_ERR(rxdata->regmap)) {
+	data->regmap = devm_regmap_init_i2c(client, &ti_tmds1204rx_regmap_config);
+	if (IS_ERR(data->regmap)) {
 		dev_err(&client->dev,
-			"regmap init failed: %ld\n", PTR_ERR(rxdata->regmap));
+			"regmap init failed: %ld\n", PTR_ERR(data->regmap));
 		ret = -ENODEV;
 		goto err_regmap;
 	}
 
-	i2c_set_clientdata(client, rxdata);
+	i2c_set_clientdata(client, data);
+
+	data->chip.name = DRIVER_NAME;
+	data->chip.dev = &client->dev;
+	data->chip.regmap = data->regmap;
+	data->chip.regs = ti_tmds1204rx_regs;
+	data->chip.num_regs = ARRAY_SIZE(ti_tmds1204rx_regs);
+	data->chip.profiles = ti_tmds1204rx_profiles;
+	data->chip.num_profiles = ARRAY_SIZE(ti_tmds1204rx_profiles);
+	ret = xfmc_chip_register(&data->chip);
+	if (ret)
+		return ret;
 
 	dev_dbg(&client->dev, "init ti_tmds1204-rx\n");
-	ret = ti_tmds1204rx_init(rxdata, 1, 0);
+	ret = ti_tmds1204rx_init(data, 1, 0);
 	if (ret) {
 		dev_err(&client->dev, "failed to init ti_tmds1204-rx\n");
 		return ret;
 	}
+
+	/* Published last, the linerate calls only see a probed chip */
+	ret = devm_add_action_or_reset(&client->dev, ti_tmds1204rx_release, NULL);
+	if (ret)
+		return ret;
+	rxdata = data;
+
 	return 0;
 
 err_regmap:
-	mutex_destroy(&rxdata->lock);
+	mutex_destroy(&data->lock);
 	return ret;
 }
 
@@ -18,7 +18,10 @@
 #include <linux/slab.h>
 #include <linux/version.h>
 
-int ti_tmds1204tx_linerate_conf(u8 is_frl, u64 linerate, u8 is_tx, u8 lanes);
+#include "xfmc.h"
+
+int ti_tmds1204tx_linerate_conf(u8 is_frl, u64 linerate, u8 is_tx, u8 lanes,
+				struct xfmc_request *req);
 void ti_tmds1204tx_exit(void);
 int ti_tmds1204tx_entry(void);
 
@@ -27,12 +30,6 @@ int ti_tmds1204tx_entry(void);
 #define to_ti_tmds1204tx(_hw)	container_of(_hw, struct ti_tmds1204tx, hw)
 struct ti_tmds1204tx *txdata;
 
-struct reg_fields {
-	u16 dev_type;
-	u8 addr;
-	u8 val;
-};
-
 enum {
 	TX_TI_R1_INIT = 0, // program 6 registers
 	TX_TI_TMDS_14_L_R1 = TX_TI_R1_INIT + 7, // 13 registers are programmed
@@ -372,6 +369,70 @@ const struct reg_fields ti_tmds1204tx_regs[] = {
 	{RX_TI_FRL_12G_R1, 0x31, 0x06},
 };
 
+/*
+ * Datapath mode, reg 0x0A[7:6]. TX runs retimed at FRL 10G/12G and on the
+ * linear redriver path for low rate TMDS; RX FRL profiles are retimed.
+ */
+static const struct xfmc_mode ti_tmds1204tx_retimer = {
+	"retimer", 0x0A, 0xC0, 0x00
+};
+static const struct xfmc_mode ti_tmds1204tx_linear = {
+	"linear", 0x0A, 0xC0, 0x40
+};
+static const struct xfmc_mode ti_tmds1204tx_limiting = {
+	"limiting", 0x0A, 0xC0, 0x80
+};
+
+static const struct xfmc_profile ti_tmds1204tx_profiles[] = {
+	{ TX_TI_R1_INIT, "TX_TI_R1_INIT", &ti_tmds1204tx_limiting },
+	{ TX_TI_TMDS_14_L_R1, "TX_TI_TMDS_14_L_R1", &ti_tmds1204tx_linear },
+	{ TX_TI_TMDS_14_H_R1, "TX_TI_TMDS_14_H_R1", &ti_tmds1204tx_limiting },
+	{ TX_TI_TMDS_20_R1, "TX_TI_TMDS_20_R1", &ti_tmds1204tx_limiting },
+	{ TX_TI_FRL_3G_R1, "TX_TI_FRL_3G_R1", &ti_tmds1204tx_limiting },
+	{ TX_TI_FRL_6G_3_R1, "TX_TI_FRL_6G_3_R1", &ti_tmds1204tx_limiting },
+	{ TX_TI_FRL_6G_4_R1, "TX_TI_FRL_6G_4_R1", &ti_tmds1204tx_limiting },
+	{ TX_TI_FRL_8G_R1, "TX_TI_FRL_8G_R1", &ti_tmds1204tx_limiting },
+	{ TX_TI_FRL_10G_R1, "TX_TI_FRL_10G_R1", &ti_tmds1204tx_retimer },
+	{ TX_TI_FRL_12G_R1, "TX_TI_FRL_12G_R1", &ti_tmds1204tx_retimer },
+	{ RX_TI_R1_INIT, "RX_TI_R1_INIT", &ti_tmds1204tx_linear },
+	{ RX_TI_TMDS_14_L_R1, "RX_TI_TMDS_14_L_R1", &ti_tmds1204tx_linear },
+	{ RX_TI_TMDS_14_H_R1, "RX_TI_TMDS_14_H_R1", &ti_tmds1204tx_linear },
+	{ RX_TI_TMDS_20_R1, "RX_TI_TMDS_20_R1", &ti_tmds1204tx_linear },
+	{ RX_TI_FRL_3G_R1, "RX_TI_FRL_3G_R1", &ti_tmds1204tx_retimer },
+	{ RX_TI_FRL_6G_3_R1, "RX_TI_FRL_6G_3_R1", &ti_tmds1204tx_retimer },
+	{ RX_TI_FRL_6G_4_R1, "RX_TI_FRL_6G_4_R1", &ti_tmds1204tx_retimer },
+	{ RX_TI_FRL_8G_R1, "RX_TI_FRL_8G_R1", &ti_tmds1204tx_retimer },
+	{ RX_TI_FRL_10G_R1, "RX_TI_FRL_10G_R1", &ti_tmds1204tx_retimer },
+	{ RX_TI_FRL_12G_R1, "RX_TI_FRL_12G_R1", &ti_tmds1204tx_retimer },
+};
+
+/* Profile of each line rate class, RX then TX, revision 1 */
+static const u16 ti_tmds1204tx_rate_profiles[2][XFMC_RATE_NUM] = {
+	{
+		[XFMC_RATE_NONE] = XFMC_PROFILE_NONE,
+		[XFMC_RATE_TMDS_14_L] = RX_TI_TMDS_20_R1,
+		[XFMC_RATE_TMDS_14_H] = RX_TI_TMDS_20_R1,
+		[XFMC_RATE_TMDS_20] = RX_TI_TMDS_20_R1,
+		[XFMC_RATE_FRL_3G] = RX_TI_FRL_3G_R1,
+		[XFMC_RATE_FRL_6G_3] = RX_TI_FRL_6G_4_R1,
+		[XFMC_RATE_FRL_6G_4] = RX_TI_FRL_6G_4_R1,
+		[XFMC_RATE_FRL_8G] = RX_TI_FRL_8G_R1,
+		[XFMC_RATE_FRL_10G] = RX_TI_FRL_10G_R1,
+		[XFMC_RATE_FRL_12G] = RX_TI_FRL_12G_R1,
+	}, {
+		[XFMC_RATE_NONE] = XFMC_PROFILE_NONE,
+		[XFMC_RATE_TMDS_14_L] = TX_TI_TMDS_14_L_R1,
+		[XFMC_RATE_TMDS_14_H] = TX_TI_TMDS_14_H_R1,
+		[XFMC_RATE_TMDS_20] = TX_TI_TMDS_20_R1,
+		[XFMC_RATE_FRL_3G] = TX_TI_FRL_3G_R1,
+		[XFMC_RATE_FRL_6G_3] = TX_TI_FRL_6G_3_R1,
+		[XFMC_RATE_FRL_6G_4] = TX_TI_FRL_6G_4_R1,
+		[XFMC_RATE_FRL_8G] = TX_TI_FRL_8G_R1,
+		[XFMC_RATE_FRL_10G] = TX_TI_FRL_10G_R1,
+		[XFMC_RATE_FRL_12G] = TX_TI_FRL_12G_R1,
+	},
+};
+
 static const struct regmap_config ti_tmds1204tx_regmap_config = {
 	.reg_bits = 8,
 	.val_bits = 8,
@@ -384,6 +445,7 @@ static const struct regmap_config ti_tmds1204tx_regmap_config = {
  * @regmap: Pointer to regmap structure
  * @lock: Mutex structure
  * @mode_index: Resolution mode index
+ * @chip: FMC core chip, tracks the applied profile
  */
 struct ti_tmds1204tx {
 	struct clk_hw hw;
@@ -391,6 +453,7 @@ struct ti_tmds1204tx {
 	struct regmap *regmap;
 	struct mutex lock; /* mutex lock for operations */
 	u32 mode_index;
+	struct xfmc_chip chip;
 };
 
 static inline int ti_tmds1204tx_read_reg(struct ti_tmds1204tx *priv, u8 addr, u8 *val)
@@ -417,81 +480,41 @@ static inline int ti_tmds1204tx_write_reg(struct ti_tmds1204tx *priv, u8 addr, u
 	return err;
 }
 
-int ti_tmds1204tx_linerate_conf(u8 is_frl, u64 linerate, u8 is_tx, u8 lanes)
+int ti_tmds1204tx_linerate_conf(u8 is_frl, u64 linerate, u8 is_tx, u8 lanes,
+				struct xfmc_request *req)
 {
-	u32 linerate_mbps;
-	u32 i = 0;
-	u16 dev_type = 0xffff;
-	int ret = 1;
+	u32 linerate_mbps, measured;
+	u16 dev_type = XFMC_PROFILE_NONE;
+	int ret;
 	u8 revision = 1;
 
-	linerate_mbps = (u32)((u64)linerate / 1000000);
+	if (!txdata)
+		return -ENODEV;
+
+	measured = (u32)((u64)linerate / 1000000);
+	linerate_mbps = measured;
+	if (!is_frl)
+		linerate_mbps = xfmc_tmds_rate(&txdata->chip, measured, req);
 	dev_info(&txdata->client->dev, "linerate %llu lineratembps %u lanes %d\n\r",
 		 linerate, linerate_mbps, lanes);
-	/* TX */
-	if (is_tx == 1) {
-		switch (revision) {
-		case 1:
-			if (is_frl == 1) {
-				if (linerate_mbps == 12000)
-					dev_type = TX_TI_FRL_12G_R1;
-				else if (linerate_mbps == 10000)
-					dev_type = TX_TI_FRL_10G_R1;
-				else if (linerate_mbps == 8000)
-					dev_type = TX_TI_FRL_8G_R1;
-				else if (linerate_mbps == 6000) {
-					if (lanes == 4)
-						dev_type = TX_TI_FRL_6G_4_R1;
-					else
-						dev_type = TX_TI_FRL_6G_3_R1;
-				} else if (linerate_mbps == 3000)
-					dev_type = TX_TI_FRL_3G_R1;
-			} else {
-				if (linerate_mbps <= 1650)
-					dev_type = TX_TI_TMDS_14_L_R1;
-				else if (linerate_mbps > 1650 &&
-					 linerate_mbps <= 3400)
-					dev_type = TX_TI_TMDS_14_H_R1;
-				else
-					dev_type = TX_TI_TMDS_20_R1;
-			}
-			break;
-		default:
-			break;
-		}
-	} else { /* RX */
-		switch (revision) {
-		case 1:
-			if (is_frl == 1) {
-				if (linerate_mbps == 12000)
-					dev_type = RX_TI_FRL_12G_R1;
-				else if (linerate_mbps == 10000)
-					dev_type = RX_TI_FRL_10G_R1;
-				else if (linerate_mbps == 8000)
-					dev_type = RX_TI_FRL_8G_R1;
-				else if (linerate_mbps == 6000)
-					dev_type = RX_TI_FRL_6G_4_R1;
-				else if (linerate_mbps == 3000)
-					dev_type = RX_TI_FRL_3G_R1;;
-			} else {
-				dev_type = RX_TI_TMDS_20_R1;
-			}
-			break;
-		default:
-
-			break;
-		}
+	switch (revision) {
+	case 1:
+		dev_type = ti_tmds1204tx_rate_profiles[is_tx == 1]
+			[xfmc_rate_classify(is_frl, linerate_mbps, lanes)];
+		break;
+	default:
+		break;
 	}
 
-	i = dev_type;
-	while (dev_type == ti_tmds1204tx_regs[i].dev_type) {
-		ret = ti_tmds1204tx_write_reg(txdata, ti_tmds1204tx_regs[i].addr,
-				       ti_tmds1204tx_regs[i].val);
-		if (ret)
-			return ret;
+	ret = xfmc_chip_apply_req(&txdata->chip, dev_type, req);
+	if (ret)
+		return ret;
+	if (!is_frl)
+		xfmc_tmds_commit(&txdata->chip, measured, linerate_mbps,
+				 req);
 
-		i++;
-	}
+	dev_dbg(&txdata->client->dev, "%s profile %s\n", is_tx ? "tx" : "rx",
+		xfmc_profile_name(&txdata->chip, dev_type));
 
 	return ret;
 }
@@ -499,9 +522,7 @@ EXPORT_SYMBOL_GPL(ti_tmds1204tx_linerate_conf);
 
 static int ti_tmds1204tx_init(struct ti_tmds1204tx *priv, u8 revision, u8 is_tx)
 {
-	int ret = 1;
 	u16 dev_type = 0xffff;
-	u32 i = 0;
 
 	if (is_tx == 1) {
 		switch (revision) {
@@ -522,54 +543,67 @@ static int ti_tmds1204tx_init(struct ti_tmds1204tx *priv, u8 revision, u8 is_tx)
 		}
 	}
 
-	i = dev_type;
-
-	while (dev_type == ti_tmds1204tx_regs[i].dev_type) {
-		ret = ti_tmds1204tx_write_reg(priv, ti_tmds1204tx_regs[i].addr,
-				       ti_tmds1204tx_regs[i].val);
-
-		if (ret)
-			return ret;
-
-		i++;
-	}
+	return xfmc_chip_apply(&priv->chip, dev_type);
+}
 
-	return ret;
+/* Unbind: stop the linerate calls from using the chip */
+static void ti_tmds1204tx_release(void *data)
+{
+	txdata = NULL;
 }
 
 static int ti_tmds1204tx_probe(struct i2c_client *client)
 {
+	struct ti_tmds1204tx *data;
 	int ret;
 
 	/* initialize ti_tmds1204 */
-	txdata = devm_kzalloc(&client->dev, sizeof(*txdata), GFP_KERNEL);
-	if (!txdata)
+	data = devm_kzalloc(&client->dev, sizeof(*data), GFP_KERNEL);
+	if (!data)
 		return -ENOMEM;
 
-	txdata->client = client;
-	mutex_init(&txdata->lock);
+	data->client = client;
+	mutex_init(&data->lock);
 
 	/* initialize regmap */
-	txdata->regmap = devm_regmap_init_i2c(client, &ti_tmds1204tx_regmap_config);
-	if (IS_ERR(txdata->regmap)) {
+	data->regmap = devm_regmap_init_i2c(client, &ti_tmds1204tx_regmap_config);
+	if (IS_ERR(data->regmap)) {
 		dev_err(&client->dev,
-			"regmap init failed: %ld\n", PTR_ERR(txdata->regmap));
+			"regmap init failed: %ld\n", PTR_ERR(data->regmap));
 		ret = -ENODEV;
 		goto err_regmap;
 	}
 
-	i2c_set_clientdata(client, txdata);
+	i2c_set_clientdata(client, data);
+
+	data->chip.name = DRIVER_NAME;
+	data->chip.dev = &client->dev;
+	data->chip.regmap = data->regmap;
+	data->chip.regs = ti_tmds1204tx_regs;
+	data->chip.num_regs = ARRAY_SIZE(ti_tmds1204tx_regs);
+	data->chip.profiles = ti_tmds1204tx_profiles;
+	data->chip.num_profiles = ARRAY_SIZE(ti_tmds1204tx_profiles);
+	ret = xfmc_chip_register(&data->chip);
+	if (ret)
+		return ret;
 
 	dev_dbg(&client->dev, "init ti_tmds1204-tx\n");
-	ret = ti_tmds1204tx_init(txdata, 1, true);
+	ret = ti_tmds1204tx_init(data, 1, true);
 	if (ret) {
 		dev_err(&client->dev, "failed to init ti_tmds1204-tx\n");
 		return ret;
 	}
+
+	/* Published last, the linerate calls only see a probed chip */
+	ret = devm_add_action_or_reset(&client->dev, ti_tmds1204tx_release, NULL);
+	if (ret)
+		return ret;
+	txdata = data;
+
 	return 0;
 
 err_regmap:
-	mutex_destroy(&txdata->lock);
+	mutex_destroy(&data->lock);
 	return ret;
 }
 
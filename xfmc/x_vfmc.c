@@ -12,6 +12,7 @@
 #include <linux/delay.h>
 #include <linux/io.h>
 #include <linux/kernel.h>
+#include <linux/math64.h>
 #include <linux/module.h>
 #include <linux/of.h>
 #include <linux/of_platform.h>
@@ -24,82 +25,145 @@
 #include <linux/list.h>
 #include <linux/slab.h>
 #include <linux/interrupt.h>
+#include <linux/workqueue.h>
 
-int onsemitx_linerate_conf(u8 is_frl, u64 linerate, u8 is_tx);
+#include "xfmc.h"
+
+/*
+ * Mode brought up by probe ahead of the rest of the FMC, for a boot splash.
+ * Built in, these are set on the command line as hdmi21_xfmc.boot_*.
+ */
+static unsigned long long boot_linerate;
+module_param(boot_linerate, ullong, 0444);
+MODULE_PARM_DESC(boot_linerate, "TX line rate (bps) set up at probe, 0 for none");
+
+static bool boot_frl;
+module_param(boot_frl, bool, 0444);
+MODULE_PARM_DESC(boot_frl, "boot_linerate is an FRL rate");
+
+static unsigned int boot_lanes = 4;
+module_param(boot_lanes, uint, 0444);
+MODULE_PARM_DESC(boot_lanes, "FRL lanes of boot_linerate");
+
+/* TX reference clock selections of sel_mux() */
+enum {
+	XVFMC_TX_REFCLK_IDT,
+	XVFMC_TX_REFCLK_SI5344,
+};
+
+int onsemitx_linerate_conf(u8 is_frl, u64 linerate, u8 is_tx,
+			   struct xfmc_request *req);
 int fmc64_tx_refclk_sel(unsigned int clk_sel);
 int fmc65_tx_refclk_sel(unsigned int clk_sel);
-int onsemirx_linerate_conf(u8 is_frl, u64 linerate, u8 is_tx);
+int onsemirx_linerate_conf(u8 is_frl, u64 linerate, u8 is_tx,
+			   struct xfmc_request *req);
 int fmc64_rx_refclk_sel(unsigned int clk_sel);
-int ti_tmds1204tx_linerate_conf(u8 is_frl, u64 linerate, u8 is_tx, u8 lanes);
-int ti_tmds1204rx_linerate_conf(u8 is_frl, u64 linerate, u8 is_tx, u8 lanes);
+int ti_tmds1204tx_linerate_conf(u8 is_frl, u64 linerate, u8 is_tx, u8 lanes,
+				struct xfmc_request *req);
+int ti_tmds1204rx_linerate_conf(u8 is_frl, u64 linerate, u8 is_tx, u8 lanes,
+				struct xfmc_request *req);
 
-static int sel_mux(int direction, int clk_sel)
+static int sel_mux_req(int direction, int clk_sel, struct xfmc_request *req)
 {
+	ktime_t start = ktime_get();
+	int ret = 0;
 #ifndef BASE_BOARD_VEK280
+	/* One read-modify-write per expander, TX switches two of them */
+	unsigned int rmw = direction ? 2 : 1;
+	u64 est_ns = xfmc_cost_est(2 * rmw, rmw * (XFMC_READ_BYTES(1) +
+						   XFMC_WRITE_BYTES(1)), 0);
+
 	if (direction)
 	{
 		printk("%s:direction is tx: clk_sel: %d\n",__func__,clk_sel);
-		fmc65_tx_refclk_sel(clk_sel);
-		fmc64_tx_refclk_sel(clk_sel);
+		ret = fmc65_tx_refclk_sel(clk_sel);
+		if (!ret)
+			ret = fmc64_tx_refclk_sel(clk_sel);
 	} else {
 		printk("%s:direction is rx: clk_sel: %d\n",__func__,clk_sel);
-		fmc64_rx_refclk_sel(clk_sel);
+		ret = fmc64_rx_refclk_sel(clk_sel);
 	}
 
+	if (!ret)
+		xfmc_cost_done(XFMC_COST_MUX, xfmc_req_id(req), 2 * rmw,
+			       rmw * (XFMC_READ_BYTES(1) + XFMC_WRITE_BYTES(1)),
+			       0, est_ns, ktime_to_ns(ktime_sub(ktime_get(), start)));
 #endif
-	return 0;
+	xfmc_rec_add("sel_mux", xfmc_req_id(req), clk_sel, direction, start,
+		     ret);
+	/* An expander not bound yet did no bus traffic worth a dump */
+	if (ret && ret != -ENODEV)
+		xfmc_rec_dump("sel_mux failed");
+	return ret;
 }
 
-static int set_linerate(u8 direction, u8 is_frl, u64 linerate, u8 lanes)
+static int sel_mux(int direction, int clk_sel)
 {
+	return sel_mux_req(direction, clk_sel, NULL);
+}
+
+static int set_linerate_req(u8 direction, u8 is_frl, u64 linerate, u8 lanes,
+			    struct xfmc_request *req)
+{
+	ktime_t start = ktime_get();
+	int ret;
+
 	printk("%s:direction is tx: isfrl: %d linerate %llu lanes %d\n",
 					__func__,is_frl,linerate,lanes);
 	if (direction) {
 		printk("%s:direction is tx: isfrl: %d linerate %llu lanes %d\n",
 						__func__,is_frl,linerate,lanes);
 #ifdef BASE_BOARD_VEK280
-		ti_tmds1204tx_linerate_conf(is_frl, linerate, direction,lanes);
+		ret = ti_tmds1204tx_linerate_conf(is_frl, linerate, direction,lanes, req);
 #else
-		onsemitx_linerate_conf(is_frl, linerate, direction);
+		ret = onsemitx_linerate_conf(is_frl, linerate, direction, req);
 #endif
 	} else {
 		printk("%s:direction is rx: isfrl: %d linerate %llu lanes %d\n",
 						__func__,is_frl,linerate,lanes);
 #ifdef BASE_BOARD_VEK280
-		ti_tmds1204rx_linerate_conf(is_frl, linerate, direction,lanes);
+		ret = ti_tmds1204rx_linerate_conf(is_frl, linerate, direction,lanes, req);
 #else
-		onsemirx_linerate_conf(is_frl, linerate, direction);
+		ret = onsemirx_linerate_conf(is_frl, linerate, direction, req);
 #endif
 
 	}
-	return 0;
+	if (req && (req->flags & XFMC_REQ_DRY_RUN))
+		return ret;
+
+	xfmc_rec_add(is_frl ? "linerate_frl" : "linerate", xfmc_req_id(req),
+		     linerate, direction, start, ret);
+	if (ret && ret != -ENODEV)
+		xfmc_rec_dump("set_linerate failed");
+	return ret;
+}
+
+static int set_linerate(u8 direction, u8 is_frl, u64 linerate, u8 lanes)
+{
+	return set_linerate_req(direction, is_frl, linerate, lanes, NULL);
 }
 
 struct x_vfmc_dev {
 	struct device *dev;
 	int val;
+	struct work_struct init_work;
 };
 
 struct fmc_drv_data {
 	const struct clk_config *clk;
 };
 
-struct clk_config {
-	int (*sel_mux)(int, int);
-	int (*set_linerate)(u8, u8, u64, u8);
-};
-
 int fmc_entry(void);
-int fmc_exit(void);
+void fmc_exit(void);
 
 int fmc64_entry(void);
-int fmc64_exit(void);
+void fmc64_exit(void);
 
 int fmc74_entry(void);
-int fmc74_exit(void);
+void fmc74_exit(void);
 
 int fmc65_entry(void);
-int fmc65_exit(void);
+void fmc65_exit(void);
 
 int tipower_entry(void);
 void tipower_exit(void);
@@ -116,16 +180,126 @@ static inline void msleep_range(unsigned int delay_base)
 	usleep_range(delay_base * 1000, delay_base * 1000 + 500);
 }
 
+/* Runs one probe phase and records it in the flight recorder */
+static int xvfmc_phase(const char *name, int (*entry)(void))
+{
+	ktime_t start = ktime_get();
+	int ret;
+
+	ret = entry();
+	xfmc_rec_add(name, 0, 0, 0, start, ret);
+
+	return ret;
+}
+
+/*
+ * TX bring-up: board power and muxes, IDT clock, TX retimer/redriver.
+ * The chip drivers stay registered when probe is deferred, their devices
+ * bind as the I2C clients show up.
+ */
+static void xvfmc_init_tx(void)
+{
+	static bool registered;
+
+	if (registered)
+		return;
+	registered = true;
+
+	xvfmc_phase("fmc74", fmc74_entry);
+#ifndef BASE_BOARD_VEK280
+	xvfmc_phase("fmc", fmc_entry);
+	xvfmc_phase("fmc65", fmc65_entry);
+	xvfmc_phase("fmc64", fmc64_entry);
+	xvfmc_phase("tipower", tipower_entry);
+#endif
+	msleep_range(300);
+	xvfmc_phase("idt", idt_entry);
+	msleep_range(300);
+#ifdef BASE_BOARD_VEK280
+	xvfmc_phase("tmds1204tx", ti_tmds1204tx_entry);
+#else
+	xvfmc_phase("onsemitx", onsemitx_entry);
+#endif
+}
+
+/* Remainder of the bring-up: RX retimer/redriver and FRL clock */
+static void xvfmc_init_rx(void)
+{
+#ifdef BASE_BOARD_VEK280
+	msleep_range(500);
+	xvfmc_phase("tmds1204rx", ti_tmds1204rx_entry);
+#else
+	msleep_range(300);
+	xvfmc_phase("onsemirx", onsemirx_entry);
+	xvfmc_phase("si5344", si5344_entry);
+#endif
+}
+
+/* TMDS clock of a line rate, a quarter of the character rate above 3.4 Gbps */
+static unsigned long xvfmc_tmds_clock(u64 linerate)
+{
+	return div_u64(linerate, linerate > 3400000000ULL ? 40 : 10);
+}
+
+/*
+ * Boot mode: TX reference clock mux, IDT rate, then the TX retimer or
+ * redriver. FRL takes its fixed 400 MHz reference from the Si5344, which
+ * runs the plan from its NVM or once the RX phase has programmed it, so
+ * the IDT is only set for TMDS. -ENODEV means a chip has not bound yet.
+ */
+static int xvfmc_boot_mode(void)
+{
+	int ret;
+
+	ret = sel_mux(1, boot_frl ? XVFMC_TX_REFCLK_SI5344 :
+			 XVFMC_TX_REFCLK_IDT);
+	if (ret)
+		return ret;
+
+	if (!boot_frl) {
+		ret = idt_clk_set_rate(xvfmc_tmds_clock(boot_linerate));
+		if (ret)
+			return ret;
+	}
+
+	return set_linerate(1, boot_frl, boot_linerate, boot_lanes);
+}
+
+static void xvfmc_init_work(struct work_struct *work)
+{
+	xvfmc_init_rx();
+}
+
+static void xvfmc_debugfs_release(void *data)
+{
+	xfmc_debugfs_exit();
+}
+
+static void xvfmc_init_cancel(void *data)
+{
+	struct x_vfmc_dev *xfmcdev = data;
+
+	cancel_work_sync(&xfmcdev->init_work);
+}
+
 /**
  * xvfmc_probe - The device probe function for driver initialization.
  * @pdev: pointer to the platform device structure.
  *
+ * With boot_linerate set, only the TX path is brought up and programmed
+ * for that line rate before probe returns; the RX path is initialized
+ * from a work item afterwards. Built in, probe runs before the I2C
+ * clients of the FMC exist and is deferred until they have bound, or
+ * until the deferred probe timeout, after which the FMC comes up without
+ * the boot mode.
+ *
  * Return: 0 for success and error value on failure
  */
 static int xvfmc_probe(struct platform_device *pdev)
 {
 	struct x_vfmc_dev *xfmcdev;
 	struct clk_config *priv_data;
+	int ret;
 
 	printk("%s %d\n",__func__,__LINE__);	
 
@@ -138,34 +312,45 @@ static int xvfmc_probe(struct platform_device *pdev)
 		return -ENOMEM;	
 	xfmcdev->dev = &pdev->dev;
 	xfmcdev->val = 5;
+	INIT_WORK(&xfmcdev->init_work, xvfmc_init_work);
 	priv_data->sel_mux = &sel_mux;
 	priv_data->set_linerate = &set_linerate; 
+	priv_data->set_linerate_req = &set_linerate_req;
+	priv_data->sel_mux_req = &sel_mux_req;
+
+	xfmc_debugfs_init();
+	ret = devm_add_action_or_reset(&pdev->dev, xvfmc_debugfs_release, NULL);
+	if (ret)
+		return ret;
+
 	/* Platform Initialization */
-	fmc74_entry();
-#ifndef BASE_BOARD_VEK280
-	fmc_entry();
-	fmc65_entry();
-	fmc64_entry();
-	tipower_entry();
-#endif
-	msleep_range(300);
-	idt_entry();
-	msleep_range(300);
-#ifdef BASE_BOARD_VEK280
-	ti_tmds1204tx_entry();
-	msleep_range(500);
-	ti_tmds1204rx_entry();
-#else
-	onsemitx_entry();
-	msleep_range(300);
-	onsemirx_entry();
-#endif
-#ifndef BASE_BOARD_VEK280
-	si5344_entry();
-#endif
+	xvfmc_init_tx();
+	if (boot_linerate) {
+		ret = xvfmc_boot_mode();
+		/* A chip that failed its probe never binds, defer until timeout */
+		if (ret == -ENODEV &&
+		    driver_deferred_probe_check_state(&pdev->dev) ==
+		    -EPROBE_DEFER)
+			return dev_err_probe(&pdev->dev, -EPROBE_DEFER,
+					     "FMC chips not bound yet\n");
+		if (ret)
+			dev_warn(&pdev->dev, "boot mode setup failed: %d\n", ret);
+
+		ret = devm_add_action_or_reset(&pdev->dev, xvfmc_init_cancel,
+					       xfmcdev);
+		if (ret)
+			return ret;
+		queue_work(system_unbound_wq, &xfmcdev->init_work);
+	} else {
+		xvfmc_init_rx();
+	}
 
 	platform_set_drvdata(pdev, priv_data);
 
+	ret = xfmc_cdev_register(&pdev->dev, priv_data);
+	if (ret)
+		return ret;
+
 	printk("%s %d\n",__func__,__LINE__);	
 	return 0;
 }
@@ -184,7 +369,20 @@ static struct platform_driver xvfmc_driver = {
 		.of_match_table	= xvfmc_of_match,
 	},
 };
+#ifdef MODULE
 module_platform_driver(xvfmc_driver);
+#else
+/* Built in, probe ahead of the display drivers so the boot splash shows */
+static int __init xvfmc_init(void)
+{
+	return platform_driver_register(&xvfmc_driver);
+}
+subsys_initcall(xvfmc_init);
+#endif
 
 MODULE_LICENSE("GPL");
 MODULE_DESCRIPTION("Xilinx Vphy driver");
+
+#if IS_ENABLED(CONFIG_VIDEO_XFMC_HDMI21_KUNIT_TEST)
+#include "x_vfmc_test.c"
+#endif
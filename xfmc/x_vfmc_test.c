@@ -0,0 +1,404 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Xilinx Video FMC driver KUnit tests, included by x_vfmc.c
+ *
+ * Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Binds the TX path chip drivers to a simulated I2C bus and runs the
+ * entry points handed to the HDMI subsystem (set_linerate, sel_mux and
+ * the IDT rate) from concurrent workers, next to a reader of the state
+ * file. Every worker ends on the same mode, so the device registers left
+ * behind must be those of a serial run of that mode.
+ */
+#include <kunit/test.h>
+#include <linux/i2c.h>
+#include <linux/seq_file.h>
+#include <linux/string.h>
+
+#define XVFMC_TEST_WORKERS	8
+#define XVFMC_TEST_LOOPS	20
+#define XVFMC_TEST_CLK		148500000
+#define XVFMC_TEST_RX_CABLE	0	/* RX reference clock of sel_mux() */
+
+void idt_exit(void);
+#ifdef BASE_BOARD_VEK280
+void ti_tmds1204tx_exit(void);
+#define XVFMC_TEST_RETIMER	"ti_tmds1204-tx"
+#else
+void onsemitx_exit(void);
+#define XVFMC_TEST_RETIMER	"onsemi-tx"
+#endif
+
+/*
+ * struct xvfmc_test_chip - chip of the TX path on the simulated bus
+ * @type: I2C device type, matched by the chip driver
+ * @addr: I2C address
+ * @reg_bytes: Register address bytes, 0 for a single latch
+ * @entry: Registers the chip driver
+ * @exit: Unregisters the chip driver
+ */
+struct xvfmc_test_chip {
+	const char *type;
+	u16 addr;
+	u8 reg_bytes;
+	int (*entry)(void);
+	void (*exit)(void);
+};
+
+static const struct xvfmc_test_chip xvfmc_test_chips[] = {
+	{ "IDT", 0x7c, 2, idt_entry, idt_exit },
+#ifdef BASE_BOARD_VEK280
+	{ "ti_tmds1204tx", 0x5e, 1, ti_tmds1204tx_entry, ti_tmds1204tx_exit },
+#else
+	{ "onsemitx", 0x5b, 1, onsemitx_entry, onsemitx_exit },
+	{ "expander-fmc64", 0x20, 0, fmc64_entry, fmc64_exit },
+	{ "expander-fmc65", 0x21, 0, fmc65_entry, fmc65_exit },
+#endif
+};
+
+#define XVFMC_TEST_CHIPS	ARRAY_SIZE(xvfmc_test_chips)
+
+/*
+ * struct xvfmc_test_dev - device state of a simulated chip
+ * @client: I2C client the chip driver binds to
+ * @regs: Register values
+ * @mask: Register address mask
+ * @ptr: Register address of the next access
+ * @registered: The chip driver was registered by the test
+ */
+struct xvfmc_test_dev {
+	struct i2c_client *client;
+	u8 *regs;
+	unsigned int mask;
+	unsigned int ptr;
+	bool registered;
+};
+
+struct xvfmc_test_bus {
+	struct i2c_adapter adap;
+	bool added;
+	struct xvfmc_test_dev dev[XVFMC_TEST_CHIPS];
+};
+
+static struct xvfmc_test_dev *xvfmc_test_dev(struct xvfmc_test_bus *bus,
+					     u16 addr)
+{
+	unsigned int i;
+
+	for (i = 0; i < XVFMC_TEST_CHIPS; i++)
+		if (xvfmc_test_chips[i].addr == addr)
+			return &bus->dev[i];
+
+	return NULL;
+}
+
+/* Register address first, big endian, then auto-incremented data */
+static int xvfmc_test_xfer(struct i2c_adapter *adap, struct i2c_msg *msgs,
+			   int num)
+{
+	struct xvfmc_test_bus *bus = i2c_get_adapdata(adap);
+	const struct xvfmc_test_chip *chip;
+	struct xvfmc_test_dev *dev;
+	unsigned int addr;
+	int i, n;
+
+	for (i = 0; i < num; i++) {
+		dev = xvfmc_test_dev(bus, msgs[i].addr);
+		if (!dev)
+			return -ENXIO;
+		chip = &xvfmc_test_chips[dev - bus->dev];
+
+		if (msgs[i].flags & I2C_M_RD) {
+			for (n = 0; n < msgs[i].len; n++)
+				msgs[i].buf[n] = dev->regs[dev->ptr++ & dev->mask];
+			continue;
+		}
+
+		if (msgs[i].len < chip->reg_bytes)
+			return -EINVAL;
+
+		addr = 0;
+		for (n = 0; n < chip->reg_bytes; n++)
+			addr = addr << 8 | msgs[i].buf[n];
+		if (chip->reg_bytes)
+			dev->ptr = addr;
+
+		for (; n < msgs[i].len; n++)
+			dev->regs[dev->ptr++ & dev->mask] = msgs[i].buf[n];
+	}
+
+	/* Leave other workers time to get in between */
+	usleep_range(5, 10);
+
+	return num;
+}
+
+static u32 xvfmc_test_func(struct i2c_adapter *adap)
+{
+	return I2C_FUNC_I2C | I2C_FUNC_SMBUS_EMUL;
+}
+
+static const struct i2c_algorithm xvfmc_test_algo = {
+	.master_xfer = xvfmc_test_xfer,
+	.functionality = xvfmc_test_func,
+};
+
+static int xvfmc_test_init(struct kunit *test)
+{
+	struct xfmc_request req = { .flags = XFMC_REQ_DRY_RUN };
+	struct i2c_board_info info = { };
+	struct xvfmc_test_bus *bus;
+	struct xvfmc_test_dev *dev;
+	unsigned int i;
+	int ret;
+
+	/* The chips of a bound FMC would take the calls */
+	if (idt_clk_set_rate_req(XVFMC_TEST_CLK, &req) != -ENODEV)
+		kunit_skip(test, "FMC chips already bound");
+
+	bus = kunit_kzalloc(test, sizeof(*bus), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, bus);
+	test->priv = bus;
+
+	bus->adap.owner = THIS_MODULE;
+	bus->adap.algo = &xvfmc_test_algo;
+	strscpy(bus->adap.name, "xvfmc-test", sizeof(bus->adap.name));
+	i2c_set_adapdata(&bus->adap, bus);
+	KUNIT_ASSERT_EQ(test, i2c_add_adapter(&bus->adap), 0);
+	bus->added = true;
+
+	for (i = 0; i < XVFMC_TEST_CHIPS; i++) {
+		dev = &bus->dev[i];
+		dev->mask = BIT(8 * xvfmc_test_chips[i].reg_bytes) - 1;
+		dev->regs = kunit_kzalloc(test, dev->mask + 1, GFP_KERNEL);
+		KUNIT_ASSERT_NOT_NULL(test, dev->regs);
+
+		ret = xvfmc_test_chips[i].entry();
+		KUNIT_ASSERT_TRUE(test, !ret || ret == -EBUSY);
+		dev->registered = !ret;
+
+		strscpy(info.type, xvfmc_test_chips[i].type, sizeof(info.type));
+		info.addr = xvfmc_test_chips[i].addr;
+		dev->client = i2c_new_client_device(&bus->adap, &info);
+		KUNIT_ASSERT_NOT_ERR_OR_NULL(test, dev->client);
+		KUNIT_ASSERT_NOT_NULL_MSG(test, dev->client->dev.driver,
+					  "%s not bound", info.type);
+	}
+
+	return 0;
+}
+
+static void xvfmc_test_exit(struct kunit *test)
+{
+	struct xvfmc_test_bus *bus = test->priv;
+	unsigned int i;
+
+	if (!bus)
+		return;
+
+	for (i = XVFMC_TEST_CHIPS; i--; )
+		if (!IS_ERR_OR_NULL(bus->dev[i].client))
+			i2c_unregister_device(bus->dev[i].client);
+
+	if (bus->added)
+		i2c_del_adapter(&bus->adap);
+
+	for (i = XVFMC_TEST_CHIPS; i--; )
+		if (bus->dev[i].registered)
+			xvfmc_test_chips[i].exit();
+}
+
+/*
+ * struct xvfmc_test_worker - concurrent caller of the entry points
+ * @work: Work running the worker
+ * @id: Worker index, selects the entry point
+ * @ret: First error of the worker
+ */
+struct xvfmc_test_worker {
+	struct work_struct work;
+	unsigned int id;
+	int ret;
+};
+
+static const struct {
+	u8 is_frl;
+	u64 linerate;
+	u8 lanes;
+} xvfmc_test_rates[] = {
+	{ 0, 1485000000ULL, 4 },	/* the final mode */
+	{ 0, 2970000000ULL, 4 },
+	{ 1, 6000000000ULL, 4 },
+	{ 0, 5940000000ULL, 4 },
+	{ 1, 12000000000ULL, 4 },
+};
+
+/* Request of loop @i, spreading the strategies and ending on a full one */
+static void xvfmc_test_req(struct xfmc_request *req, unsigned int id,
+			   unsigned int i)
+{
+	memset(req, 0, sizeof(*req));
+	req->id = (u64)id << 32 | i;
+	if (i == XVFMC_TEST_LOOPS)
+		return;
+
+	req->flags = (id + i) % 3 == 1 ? XFMC_REQ_VERIFY : 0;
+	req->budget_us = (id + i) % 3 == 2 ? 1 : 0;
+}
+
+static void xvfmc_test_linerate_work(struct work_struct *work)
+{
+	struct xvfmc_test_worker *w = container_of(work,
+						   struct xvfmc_test_worker,
+						   work);
+	struct xfmc_request req;
+	unsigned int i, r;
+
+	for (i = 0; i <= XVFMC_TEST_LOOPS && !w->ret; i++) {
+		r = i < XVFMC_TEST_LOOPS ?
+		    (w->id + i) % ARRAY_SIZE(xvfmc_test_rates) : 0;
+		xvfmc_test_req(&req, w->id, i);
+		w->ret = set_linerate_req(1, xvfmc_test_rates[r].is_frl,
+					  xvfmc_test_rates[r].linerate,
+					  xvfmc_test_rates[r].lanes, &req);
+	}
+}
+
+/* TX and RX reference clocks, ending on the IDT and the cable */
+static void xvfmc_test_mux_work(struct work_struct *work)
+{
+	struct xvfmc_test_worker *w = container_of(work,
+						   struct xvfmc_test_worker,
+						   work);
+	struct xfmc_request req;
+	unsigned int i;
+
+	for (i = 0; i <= XVFMC_TEST_LOOPS && !w->ret; i++) {
+		xvfmc_test_req(&req, w->id, i);
+		w->ret = sel_mux_req(1, i < XVFMC_TEST_LOOPS ? i & 1 :
+				     XVFMC_TX_REFCLK_IDT, &req);
+		if (!w->ret)
+			w->ret = sel_mux_req(0, i < XVFMC_TEST_LOOPS ? ~i & 1 :
+					     XVFMC_TEST_RX_CABLE, &req);
+	}
+}
+
+static void xvfmc_test_clk_work(struct work_struct *work)
+{
+	struct xvfmc_test_worker *w = container_of(work,
+						   struct xvfmc_test_worker,
+						   work);
+	static const unsigned long rates[] = {
+		74250000, 27000000, 297000000, XVFMC_TEST_CLK,
+	};
+	struct xfmc_request req;
+	unsigned int i;
+
+	for (i = 0; i <= XVFMC_TEST_LOOPS && !w->ret; i++) {
+		xvfmc_test_req(&req, w->id, i);
+		w->ret = idt_clk_set_rate_req(i < XVFMC_TEST_LOOPS ?
+					      rates[(w->id + i) %
+						    ARRAY_SIZE(rates)] :
+					      XVFMC_TEST_CLK, &req);
+	}
+}
+
+/* Reads the state file, which must list the retimer every time */
+static void xvfmc_test_state_work(struct work_struct *work)
+{
+	struct xvfmc_test_worker *w = container_of(work,
+						   struct xvfmc_test_worker,
+						   work);
+	struct seq_file s = { };
+	unsigned int i;
+
+	s.size = PAGE_SIZE;
+	s.buf = kmalloc(s.size, GFP_KERNEL);
+	if (!s.buf) {
+		w->ret = -ENOMEM;
+		return;
+	}
+
+	for (i = 0; i < XVFMC_TEST_LOOPS && !w->ret; i++) {
+		s.count = 0;
+		w->ret = xfmc_state_show(&s, NULL);
+		if (!w->ret && (seq_has_overflowed(&s) ||
+				!strnstr(s.buf, XVFMC_TEST_RETIMER ": profile ",
+					 s.count)))
+			w->ret = -EIO;
+	}
+
+	kfree(s.buf);
+}
+
+static const work_func_t xvfmc_test_work[] = {
+	xvfmc_test_linerate_work,
+	xvfmc_test_mux_work,
+	xvfmc_test_clk_work,
+	xvfmc_test_state_work,
+};
+
+static void xvfmc_test_entry_stress(struct kunit *test)
+{
+	struct xvfmc_test_bus *bus = test->priv;
+	u8 *before[XVFMC_TEST_CHIPS];
+	struct xfmc_request req = { 0 };
+	struct xvfmc_test_worker *w;
+	struct workqueue_struct *wq;
+	unsigned int i;
+
+	w = kunit_kcalloc(test, XVFMC_TEST_WORKERS, sizeof(*w), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, w);
+
+	wq = alloc_workqueue("xvfmc-test", WQ_UNBOUND, XVFMC_TEST_WORKERS);
+	KUNIT_ASSERT_NOT_NULL(test, wq);
+
+	for (i = 0; i < XVFMC_TEST_WORKERS; i++) {
+		w[i].id = i;
+		INIT_WORK(&w[i].work,
+			  xvfmc_test_work[i % ARRAY_SIZE(xvfmc_test_work)]);
+		queue_work(wq, &w[i].work);
+	}
+	destroy_workqueue(wq);
+
+	for (i = 0; i < XVFMC_TEST_WORKERS; i++)
+		KUNIT_EXPECT_EQ_MSG(test, w[i].ret, 0, "worker %u", i);
+
+	KUNIT_EXPECT_EQ(test, xfmc_chip_verify(XVFMC_TEST_RETIMER), 0);
+
+	/* Run the final mode again, serially: no register may change */
+	for (i = 0; i < XVFMC_TEST_CHIPS; i++) {
+		before[i] = kunit_kmalloc(test, bus->dev[i].mask + 1,
+					  GFP_KERNEL);
+		KUNIT_ASSERT_NOT_NULL(test, before[i]);
+		memcpy(before[i], bus->dev[i].regs, bus->dev[i].mask + 1);
+	}
+
+	KUNIT_EXPECT_EQ(test, set_linerate_req(1, xvfmc_test_rates[0].is_frl,
+					       xvfmc_test_rates[0].linerate,
+					       xvfmc_test_rates[0].lanes,
+					       &req), 0);
+	KUNIT_EXPECT_EQ(test, sel_mux_req(1, XVFMC_TX_REFCLK_IDT, &req), 0);
+	KUNIT_EXPECT_EQ(test, sel_mux_req(0, XVFMC_TEST_RX_CABLE, &req), 0);
+	req.flags = XFMC_REQ_VERIFY;
+	KUNIT_EXPECT_EQ(test, idt_clk_set_rate_req(XVFMC_TEST_CLK, &req), 0);
+	KUNIT_EXPECT_EQ(test, req.strategy, XFMC_STRATEGY_VERIFY);
+
+	for (i = 0; i < XVFMC_TEST_CHIPS; i++)
+		KUNIT_EXPECT_MEMEQ_MSG(test, bus->dev[i].regs, before[i],
+				       bus->dev[i].mask + 1, "%s",
+				       xvfmc_test_chips[i].type);
+}
+
+static struct kunit_case xvfmc_test_cases[] = {
+	KUNIT_CASE_SLOW(xvfmc_test_entry_stress),
+	{}
+};
+
+static struct kunit_suite xvfmc_test_suite = {
+	.name = "xfmc-entry",
+	.init = xvfmc_test_init,
+	.exit = xvfmc_test_exit,
+	.test_cases = xvfmc_test_cases,
+};
+
+kunit_test_suite(xvfmc_test_suite);
@@ -0,0 +1,185 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Xilinx Video FMC common definitions
+ *
+ * Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+ *
+ */
+#ifndef __XFMC_H__
+#define __XFMC_H__
+
+#include <linux/ktime.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/regmap.h>
+#include <linux/types.h>
+
+#include "xfmc_ioctl.h"
+#include "xfmc_plan.h"
+
+#define XFMC_PROFILE_NONE	0xffff
+
+/* Bus bytes of one register access with @rb register address bytes */
+#define XFMC_WRITE_BYTES(rb)	(1 + (rb) + 1)
+#define XFMC_READ_BYTES(rb)	(2 + (rb) + 1)
+
+/* Kinds of operations measured by the bus cost model */
+enum xfmc_cost_op {
+	XFMC_COST_PROFILE,
+	XFMC_COST_CLOCK,
+	XFMC_COST_MUX,
+	XFMC_COST_SNAPSHOT,
+	XFMC_COST_NUM,
+};
+
+/*
+ * Register table entry shared by the retimer/redriver drivers.
+ * Entries of one profile are contiguous and the profile id (dev_type)
+ * is the index of its first entry.
+ */
+struct reg_fields {
+	u16 dev_type;
+	u8 addr;
+	u8 val;
+};
+
+/*
+ * Operations handed to the HDMI subsystem through the platform drvdata.
+ * The _req variants take an optional request, whose id ties the FMC
+ * work to the event of the caller that triggered it.
+ */
+struct clk_config {
+	int (*sel_mux)(int, int);
+	int (*set_linerate)(u8, u8, u64, u8);
+	int (*set_linerate_req)(u8, u8, u64, u8, struct xfmc_request *);
+	int (*sel_mux_req)(int, int, struct xfmc_request *);
+};
+
+/*
+ * struct xfmc_mode - datapath operating mode of a chip
+ * @name: Mode name, reported in debugfs
+ * @addr: Register holding the mode field
+ * @mask: Mode field
+ * @val: Field value of the mode
+ */
+struct xfmc_mode {
+	const char *name;
+	u8 addr;
+	u8 mask;
+	u8 val;
+};
+
+/*
+ * struct xfmc_profile - named profile of a chip register table
+ * @dev_type: Profile id, index of its first table entry
+ * @name: Profile name
+ * @mode: Operating mode selected with the profile, NULL to keep it
+ */
+struct xfmc_profile {
+	u16 dev_type;
+	const char *name;
+	const struct xfmc_mode *mode;
+};
+
+/*
+ * struct xfmc_chip - chip registered with the FMC core
+ * @name: Chip name, used as key in debugfs
+ * @dev: Pointer to the chip device
+ * @regmap: Pointer to regmap structure
+ * @regs: Register table of the chip
+ * @num_regs: Number of entries in @regs
+ * @profiles: Names of the profiles in the chip register table
+ * @num_profiles: Number of entries in @profiles
+ * @profile: Currently applied profile, XFMC_PROFILE_NONE if none
+ * @mode: Current operating mode, NULL if unknown
+ * @tmds_mbps: Last TMDS rate after hysteresis, 0 if none
+ * @tmds_band: TMDS band of @tmds_mbps and the one before it
+ * @tmds_changes: TMDS band changes
+ * @tmds_flaps: TMDS band changes back to the band before the last one
+ * @tmds_held: TMDS band changes suppressed by hysteresis
+ * @tmds_scale: Units of the TMDS rates of the driver per Mbps, 0 for 1
+ * @revision: Chip revision reported in snapshots, 0 if unknown
+ * @dump: Register ranges of snapshots, NULL for 0 to the highest
+ *	  register of @regs
+ * @num_dump: Number of entries in @dump
+ * @dump_regs: Default snapshot range
+ * @failed: Snapshot taken when a profile change last failed
+ * @failed_len: Size of @failed, 0 if none was taken
+ * @debugfs: Snapshot directory of the chip in debugfs
+ * @lock: Protects @profile, @mode, the TMDS state, @failed and @overrides
+ * @overrides: Runtime register overrides
+ * @list: Entry in the list of registered chips
+ */
+struct xfmc_chip {
+	const char *name;
+	struct device *dev;
+	struct regmap *regmap;
+	const struct reg_fields *regs;
+	unsigned int num_regs;
+	const struct xfmc_profile *profiles;
+	unsigned int num_profiles;
+	u16 profile;
+	const struct xfmc_mode *mode;
+	u32 tmds_mbps;
+	u8 tmds_band[2];
+	unsigned int tmds_changes;
+	unsigned int tmds_flaps;
+	unsigned int tmds_held;
+	u32 tmds_scale;
+	u32 revision;
+	const struct regmap_range *dump;
+	unsigned int num_dump;
+	struct regmap_range dump_regs;
+	void *failed;
+	size_t failed_len;
+	struct dentry *debugfs;
+	struct mutex lock; /* protects profile, mode, tmds, failed, overrides */
+	struct list_head overrides;
+	struct list_head list;
+};
+
+int xfmc_chip_register(struct xfmc_chip *chip);
+void xfmc_chip_unregister(struct xfmc_chip *chip);
+const char *xfmc_profile_name(struct xfmc_chip *chip, u16 dev_type);
+int xfmc_chip_apply(struct xfmc_chip *chip, u16 dev_type);
+int xfmc_chip_apply_req(struct xfmc_chip *chip, u16 dev_type,
+			struct xfmc_request *req);
+int xfmc_chip_verify(const char *name);
+u32 xfmc_tmds_rate(struct xfmc_chip *chip, u32 mbps,
+		   const struct xfmc_request *req);
+void xfmc_tmds_commit(struct xfmc_chip *chip, u32 mbps, u32 rate,
+		      const struct xfmc_request *req);
+int xfmc_override_update(const char *name, u16 dev_type, u8 addr, u8 val,
+			 bool remove);
+
+int xfmc_cdev_register(struct device *dev, const struct clk_config *ops);
+
+u64 xfmc_cost_est(unsigned int xfers, unsigned int bytes, u32 settle_us);
+u32 xfmc_cost_us(unsigned int xfers, unsigned int bytes, u32 settle_us);
+void xfmc_cost_done(enum xfmc_cost_op op, u64 id, unsigned int xfers,
+		    unsigned int bytes, u32 settle_us, u64 est_ns, u64 ns);
+
+int idt_clk_set_rate(unsigned long rate);
+int idt_clk_set_rate_req(unsigned long rate, struct xfmc_request *req);
+
+int xfmc_debugfs_init(void);
+void xfmc_debugfs_exit(void);
+
+struct dentry;
+struct file_operations;
+struct seq_file;
+
+int xfmc_state_show(struct seq_file *s, void *unused);
+
+size_t xfmc_snapshot_size(struct xfmc_chip *chip);
+int xfmc_snapshot_locked(struct xfmc_chip *chip, void *buf, size_t len);
+extern const struct file_operations xfmc_snapshot_fops;
+extern const struct file_operations xfmc_snapshot_failed_fops;
+
+void xfmc_rec_add(const char *op, u64 id, u64 arg, u32 aux, ktime_t start,
+		  int ret);
+void xfmc_rec_dump(const char *why);
+void xfmc_rec_debugfs_init(struct dentry *root);
+void xfmc_cost_debugfs_init(struct dentry *root);
+
+#endif /* __XFMC_H__ */
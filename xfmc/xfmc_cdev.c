@@ -0,0 +1,237 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Xilinx Video FMC control device
+ *
+ * Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Exposes /dev/xfmcN for test automation. A batch of operations is
+ * copied in once, run back to back and returned with per-operation
+ * status and timing.
+ *
+ * Open files keep the device structure alive after the FMC is unbound;
+ * their ioctls then fail with -ENODEV.
+ */
+#include <linux/device.h>
+#include <linux/fs.h>
+#include <linux/idr.h>
+#include <linux/kernel.h>
+#include <linux/kref.h>
+#include <linux/ktime.h>
+#include <linux/miscdevice.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+
+#include "xfmc.h"
+#include "xfmc_ioctl.h"
+
+struct xfmc_cdev {
+	struct miscdevice misc;
+	const struct clk_config *ops;
+	struct kref ref;
+	struct mutex lock; /* serializes batches, protects dead */
+	bool dead;
+	int id;
+	char name[16];
+};
+
+static DEFINE_IDA(xfmc_cdev_ida);
+
+static int xfmc_cdev_run_op(struct xfmc_cdev *cdev, struct xfmc_op *op)
+{
+	struct xfmc_request req = { .id = op->id, .flags = op->flags };
+	int ret;
+
+	switch (op->op) {
+	case XFMC_OP_SET_LINERATE:
+		req.budget_us = op->arg.linerate.budget_us;
+		ret = cdev->ops->set_linerate_req(op->arg.linerate.direction,
+						  op->arg.linerate.is_frl,
+						  op->arg.linerate.linerate,
+						  op->arg.linerate.lanes, &req);
+		op->strategy = req.strategy;
+		op->estimate_ns = req.estimate_ns;
+		return ret;
+	case XFMC_OP_SEL_MUX:
+		return cdev->ops->sel_mux_req(op->arg.mux.direction,
+					      op->arg.mux.clk_sel, &req);
+	case XFMC_OP_CLK_RATE:
+		req.budget_us = op->arg.clk.budget_us;
+		ret = idt_clk_set_rate_req(op->arg.clk.rate, &req);
+		op->strategy = req.strategy;
+		op->estimate_ns = req.estimate_ns;
+		return ret;
+	case XFMC_OP_OVERRIDE:
+		op->arg.reg.chip[XFMC_CHIP_NAME_LEN - 1] = '\0';
+		return xfmc_override_update(op->arg.reg.chip,
+					    op->arg.reg.profile,
+					    op->arg.reg.addr, op->arg.reg.val,
+					    op->flags & XFMC_OP_F_REMOVE);
+	case XFMC_OP_VERIFY:
+		op->arg.reg.chip[XFMC_CHIP_NAME_LEN - 1] = '\0';
+		return xfmc_chip_verify(op->arg.reg.chip);
+	default:
+		return -EINVAL;
+	}
+}
+
+static long xfmc_cdev_batch(struct xfmc_cdev *cdev,
+			    struct xfmc_batch __user *ubatch)
+{
+	struct xfmc_batch batch;
+	struct xfmc_op *ops;
+	ktime_t start, t;
+	size_t size;
+	long ret = 0;
+	u32 i;
+
+	if (copy_from_user(&batch, ubatch, sizeof(batch)))
+		return -EFAULT;
+
+	if (!batch.num_ops || batch.num_ops > XFMC_BATCH_MAX)
+		return -EINVAL;
+
+	size = array_size(batch.num_ops, sizeof(*ops));
+	ops = memdup_user(u64_to_user_ptr(batch.ops), size);
+	if (IS_ERR(ops))
+		return PTR_ERR(ops);
+
+	mutex_lock(&cdev->lock);
+	if (cdev->dead) {
+		mutex_unlock(&cdev->lock);
+		kfree(ops);
+		return -ENODEV;
+	}
+
+	start = ktime_get();
+	for (i = 0; i < batch.num_ops; i++) {
+		t = ktime_get();
+		ops[i].status = xfmc_cdev_run_op(cdev, &ops[i]);
+		ops[i].duration_ns = ktime_to_ns(ktime_sub(ktime_get(), t));
+		if (ops[i].status && (batch.flags & XFMC_BATCH_STOP_ON_ERROR)) {
+			i++;
+			break;
+		}
+	}
+	batch.total_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	batch.completed = i;
+	mutex_unlock(&cdev->lock);
+
+	if (copy_to_user(u64_to_user_ptr(batch.ops), ops, size) ||
+	    copy_to_user(ubatch, &batch, sizeof(batch)))
+		ret = -EFAULT;
+
+	kfree(ops);
+
+	return ret;
+}
+
+static long xfmc_cdev_ioctl(struct file *file, unsigned int cmd,
+			    unsigned long arg)
+{
+	struct xfmc_cdev *cdev = file->private_data;
+
+	switch (cmd) {
+	case XFMC_IOC_BATCH:
+		return xfmc_cdev_batch(cdev, (struct xfmc_batch __user *)arg);
+	default:
+		return -ENOTTY;
+	}
+}
+
+static void xfmc_cdev_free(struct kref *ref)
+{
+	struct xfmc_cdev *cdev = container_of(ref, struct xfmc_cdev, ref);
+
+	ida_free(&xfmc_cdev_ida, cdev->id);
+	mutex_destroy(&cdev->lock);
+	kfree(cdev);
+}
+
+static int xfmc_cdev_open(struct inode *inode, struct file *file)
+{
+	/* misc_open() points private_data at the miscdevice */
+	struct xfmc_cdev *cdev = container_of(file->private_data,
+					      struct xfmc_cdev, misc);
+
+	kref_get(&cdev->ref);
+	file->private_data = cdev;
+
+	return 0;
+}
+
+static int xfmc_cdev_file_release(struct inode *inode, struct file *file)
+{
+	struct xfmc_cdev *cdev = file->private_data;
+
+	kref_put(&cdev->ref, xfmc_cdev_free);
+
+	return 0;
+}
+
+static const struct file_operations xfmc_cdev_fops = {
+	.owner = THIS_MODULE,
+	.open = xfmc_cdev_open,
+	.release = xfmc_cdev_file_release,
+	.unlocked_ioctl = xfmc_cdev_ioctl,
+	.compat_ioctl = compat_ptr_ioctl,
+};
+
+static void xfmc_cdev_release(void *data)
+{
+	struct xfmc_cdev *cdev = data;
+
+	misc_deregister(&cdev->misc);
+
+	/* Waits for a running batch, the ops go away with the FMC device */
+	mutex_lock(&cdev->lock);
+	cdev->dead = true;
+	mutex_unlock(&cdev->lock);
+
+	kref_put(&cdev->ref, xfmc_cdev_free);
+}
+
+/**
+ * xfmc_cdev_register - Create the /dev/xfmcN control device
+ * @dev: FMC platform device
+ * @ops: line rate and mux operations of the FMC
+ *
+ * The device is removed automatically when @dev is unbound. Files still
+ * open stay valid, but their operations fail with -ENODEV.
+ *
+ * Return: 0 for success and error value on failure
+ */
+int xfmc_cdev_register(struct device *dev, const struct clk_config *ops)
+{
+	struct xfmc_cdev *cdev;
+	int ret;
+
+	cdev = kzalloc(sizeof(*cdev), GFP_KERNEL);
+	if (!cdev)
+		return -ENOMEM;
+
+	cdev->id = ida_alloc(&xfmc_cdev_ida, GFP_KERNEL);
+	if (cdev->id < 0) {
+		ret = cdev->id;
+		kfree(cdev);
+		return ret;
+	}
+
+	snprintf(cdev->name, sizeof(cdev->name), "xfmc%d", cdev->id);
+	kref_init(&cdev->ref);
+	mutex_init(&cdev->lock);
+	cdev->ops = ops;
+	cdev->misc.minor = MISC_DYNAMIC_MINOR;
+	cdev->misc.name = cdev->name;
+	cdev->misc.fops = &xfmc_cdev_fops;
+	cdev->misc.parent = dev;
+
+	ret = misc_register(&cdev->misc);
+	if (ret) {
+		dev_err(dev, "failed to register %s\n", cdev->name);
+		kref_put(&cdev->ref, xfmc_cdev_free);
+		return ret;
+	}
+
+	return devm_add_action_or_reset(dev, xfmc_cdev_release, cdev);
+}
@@ -0,0 +1,906 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Xilinx Video FMC core
+ *
+ * Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Keeps track of the retimer/redriver chips on the FMC and programs their
+ * register profiles. Single registers of a profile can be overridden at
+ * runtime through debugfs, keyed by (chip, profile, register):
+ *
+ *   echo "add ti_tmds1204-tx TX_TI_FRL_12G_R1 0x12 0x02" > overrides
+ *   echo "del ti_tmds1204-tx TX_TI_FRL_12G_R1 0x12" > overrides
+ *   echo "clear" > overrides
+ *
+ * Overrides are merged into the profile the next time it is selected.
+ * A profile can select an operating mode of the chip, a register field
+ * that is updated with one masked write before the profile is written.
+ *
+ * TMDS rates near the 1650 and 3400 Mbps band boundaries are held in their
+ * previous band until they move past the boundary by a margin, set with
+ * the tmds_hyst_1650 and tmds_hyst_3400 module parameters, in Mbps. The
+ * band is only recorded once the profile of the rate is applied.
+ *
+ * Register snapshots of every chip are read through debugfs, and one is
+ * kept per chip from the last failed profile change.
+ *
+ * A profile change can carry a latency budget. The strategy requested by
+ * the caller (full rewrite by default, read back on request) falls back
+ * to cheaper ones until its estimated bus time fits the budget, down to
+ * writing only the registers whose cached value changes. Strategy costs
+ * come from the bus cost model, which is fitted to every profile change;
+ * XFMC_REQ_DRY_RUN returns the estimate without programming anything.
+ */
+#include <linux/debugfs.h>
+#include <linux/device.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/lockdep.h>
+#include <linux/module.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+
+#include "xfmc.h"
+
+#define XFMC_CMD_MAX	128
+
+struct xfmc_override {
+	struct list_head list;
+	u16 dev_type;
+	u8 addr;
+	u8 val;
+};
+
+static unsigned int tmds_hyst_1650 = 20;
+module_param(tmds_hyst_1650, uint, 0644);
+MODULE_PARM_DESC(tmds_hyst_1650, "Hysteresis at the 1650 Mbps TMDS boundary");
+
+static unsigned int tmds_hyst_3400 = 20;
+module_param(tmds_hyst_3400, uint, 0644);
+MODULE_PARM_DESC(tmds_hyst_3400, "Hysteresis at the 3400 Mbps TMDS boundary");
+
+static LIST_HEAD(xfmc_chips);
+static DEFINE_MUTEX(xfmc_chips_lock);
+static struct dentry *xfmc_debugfs_root;
+static struct dentry *xfmc_snapshot_dir;
+
+static void xfmc_chip_debugfs_init(struct xfmc_chip *chip)
+{
+	lockdep_assert_held(&xfmc_chips_lock);
+
+	if (!xfmc_snapshot_dir || !chip->failed)
+		return;
+
+	chip->debugfs = debugfs_create_dir(chip->name, xfmc_snapshot_dir);
+	debugfs_create_file("regs", 0400, chip->debugfs, chip,
+			    &xfmc_snapshot_fops);
+	debugfs_create_file("failed", 0400, chip->debugfs, chip,
+			    &xfmc_snapshot_failed_fops);
+}
+
+void xfmc_chip_unregister(struct xfmc_chip *chip)
+{
+	struct xfmc_override *ov, *tmp;
+
+	mutex_lock(&xfmc_chips_lock);
+	list_del(&chip->list);
+	if (xfmc_snapshot_dir)
+		debugfs_remove_recursive(chip->debugfs);
+	chip->debugfs = NULL;
+	mutex_unlock(&xfmc_chips_lock);
+
+	list_for_each_entry_safe(ov, tmp, &chip->overrides, list) {
+		list_del(&ov->list);
+		kfree(ov);
+	}
+	mutex_destroy(&chip->lock);
+}
+
+static void xfmc_chip_release(void *data)
+{
+	xfmc_chip_unregister(data);
+}
+
+/**
+ * xfmc_chip_register - Register a chip with the FMC core
+ * @chip: chip to register, with name, dev, regmap, regs and profiles set
+ *
+ * The snapshot ranges default to the registers from 0 to the highest one
+ * of the register table. The chip is unregistered automatically when
+ * @chip->dev is unbound.
+ *
+ * Return: 0 for success and error value on failure
+ */
+int xfmc_chip_register(struct xfmc_chip *chip)
+{
+	unsigned int i;
+	size_t len;
+
+	if (!chip->dump && chip->num_regs) {
+		chip->dump_regs.range_min = 0;
+		chip->dump_regs.range_max = 0;
+		for (i = 0; i < chip->num_regs; i++)
+			chip->dump_regs.range_max = max_t(unsigned int,
+				chip->dump_regs.range_max, chip->regs[i].addr);
+		chip->dump = &chip->dump_regs;
+		chip->num_dump = 1;
+	}
+
+	len = xfmc_snapshot_size(chip);
+	if (len) {
+		chip->failed = devm_kzalloc(chip->dev, len, GFP_KERNEL);
+		if (!chip->failed)
+			return -ENOMEM;
+	}
+
+	mutex_init(&chip->lock);
+	INIT_LIST_HEAD(&chip->overrides);
+	chip->profile = XFMC_PROFILE_NONE;
+
+	mutex_lock(&xfmc_chips_lock);
+	list_add_tail(&chip->list, &xfmc_chips);
+	xfmc_chip_debugfs_init(chip);
+	mutex_unlock(&xfmc_chips_lock);
+
+	return devm_add_action_or_reset(chip->dev, xfmc_chip_release, chip);
+}
+
+static const struct xfmc_profile *xfmc_profile_find(struct xfmc_chip *chip,
+						   u16 dev_type)
+{
+	unsigned int i;
+
+	for (i = 0; i < chip->num_profiles; i++)
+		if (chip->profiles[i].dev_type == dev_type)
+			return &chip->profiles[i];
+
+	return NULL;
+}
+
+const char *xfmc_profile_name(struct xfmc_chip *chip, u16 dev_type)
+{
+	const struct xfmc_profile *profile;
+
+	if (dev_type == XFMC_PROFILE_NONE)
+		return "none";
+
+	profile = xfmc_profile_find(chip, dev_type);
+
+	return profile ? profile->name : "unknown";
+}
+
+static struct xfmc_override *xfmc_override_find(struct xfmc_chip *chip,
+						u16 dev_type, u8 addr)
+{
+	struct xfmc_override *ov;
+
+	lockdep_assert_held(&chip->lock);
+
+	list_for_each_entry(ov, &chip->overrides, list)
+		if (ov->dev_type == dev_type && ov->addr == addr)
+			return ov;
+
+	return NULL;
+}
+
+static int xfmc_chip_write(struct xfmc_chip *chip, u8 addr, u8 val,
+			   bool delta)
+{
+	int err;
+
+	if (delta)
+		err = regmap_update_bits(chip->regmap, addr, 0xff, val);
+	else
+		err = regmap_write(chip->regmap, addr, val);
+	if (err)
+		dev_dbg(chip->dev, "i2c write failed, addr = %x\n", addr);
+
+	return err;
+}
+
+/* Index one past the last table entry of @dev_type, 0 if not a profile */
+static unsigned int xfmc_profile_end(struct xfmc_chip *chip, u16 dev_type)
+{
+	unsigned int end;
+
+	if (dev_type >= chip->num_regs ||
+	    chip->regs[dev_type].dev_type != dev_type)
+		return 0;
+
+	for (end = dev_type; end < chip->num_regs; end++)
+		if (chip->regs[end].dev_type != dev_type)
+			break;
+
+	return end;
+}
+
+static bool xfmc_profile_writes(struct xfmc_chip *chip, unsigned int from,
+				unsigned int end, u8 addr)
+{
+	unsigned int i;
+
+	for (i = from; i < end; i++)
+		if (chip->regs[i].addr == addr)
+			return true;
+
+	return false;
+}
+
+/*
+ * Value written by table entry @i of its profile. An override replaces
+ * the last write to its register.
+ */
+static u8 xfmc_profile_val(struct xfmc_chip *chip, unsigned int i,
+			   unsigned int end)
+{
+	const struct reg_fields *reg = &chip->regs[i];
+	struct xfmc_override *ov;
+
+	lockdep_assert_held(&chip->lock);
+
+	if (xfmc_profile_writes(chip, i + 1, end, reg->addr))
+		return reg->val;
+
+	ov = xfmc_override_find(chip, reg->dev_type, reg->addr);
+
+	return ov ? ov->val : reg->val;
+}
+
+/* Overrides of registers that the profile does not write */
+static bool xfmc_override_extra(struct xfmc_chip *chip,
+				struct xfmc_override *ov, u16 dev_type,
+				unsigned int end)
+{
+	return ov->dev_type == dev_type &&
+	       !xfmc_profile_writes(chip, dev_type, end, ov->addr);
+}
+
+/**
+ * xfmc_tmds_rate - Apply band hysteresis to a TMDS line rate
+ * @chip: chip the rate is programmed on
+ * @mbps: measured line rate, in the units of the driver band thresholds
+ * @req: request of the rate change
+ *
+ * Applies xfmc_tmds_hold() with the margins of the module parameters to
+ * the last rate of the chip. The margins are in Mbps and are scaled by
+ * @chip->tmds_scale to the units of @mbps. The state of the chip is left
+ * alone, the caller records the rate with xfmc_tmds_commit() once its
+ * profile is applied.
+ *
+ * Return: the rate to classify the band with
+ */
+u32 xfmc_tmds_rate(struct xfmc_chip *chip, u32 mbps,
+		   const struct xfmc_request *req)
+{
+	u32 scale = chip->tmds_scale ?: 1;
+	const u32 margins[XFMC_TMDS_BOUNDS] = {
+		tmds_hyst_1650 * scale, tmds_hyst_3400 * scale
+	};
+	u32 rate;
+
+	mutex_lock(&chip->lock);
+	rate = xfmc_tmds_hold(chip->tmds_mbps, mbps, margins);
+	mutex_unlock(&chip->lock);
+
+	if (rate != mbps)
+		dev_dbg(chip->dev, "%llx tmds %u held at %u\n",
+			xfmc_req_id(req), mbps, rate);
+
+	return rate;
+}
+EXPORT_SYMBOL_GPL(xfmc_tmds_rate);
+
+/**
+ * xfmc_tmds_commit - Record the TMDS rate of an applied profile
+ * @chip: chip the rate is programmed on
+ * @mbps: measured line rate passed to xfmc_tmds_rate()
+ * @rate: rate returned by xfmc_tmds_rate()
+ * @req: request of the rate change, the state is kept for a dry run
+ *
+ * Makes @rate the last rate of the chip and counts the band changes.
+ * Called only after the profile of @rate was applied, so a failed
+ * change leaves the hysteresis at the rate the chip is still set to.
+ */
+void xfmc_tmds_commit(struct xfmc_chip *chip, u32 mbps, u32 rate,
+		      const struct xfmc_request *req)
+{
+	u8 band = xfmc_tmds_band(rate);
+
+	if (req && (req->flags & XFMC_REQ_DRY_RUN))
+		return;
+
+	mutex_lock(&chip->lock);
+	if (band != xfmc_tmds_band(mbps))
+		chip->tmds_held++;
+
+	if (chip->tmds_mbps && band != chip->tmds_band[0]) {
+		chip->tmds_changes++;
+		if (band == chip->tmds_band[1])
+			chip->tmds_flaps++;
+		chip->tmds_band[1] = chip->tmds_band[0];
+	}
+	chip->tmds_band[0] = band;
+	chip->tmds_mbps = rate;
+	mutex_unlock(&chip->lock);
+}
+EXPORT_SYMBOL_GPL(xfmc_tmds_commit);
+
+static int xfmc_chip_check(struct xfmc_chip *chip, u8 addr, u8 val)
+{
+	unsigned int data;
+	int err;
+
+	err = regmap_read(chip->regmap, addr, &data);
+	if (err)
+		return err;
+
+	if (data != val) {
+		dev_dbg(chip->dev, "verify failed, addr = %x: %x != %x\n",
+			addr, data, val);
+		return -EIO;
+	}
+
+	return 0;
+}
+
+static int xfmc_chip_verify_locked(struct xfmc_chip *chip)
+{
+	u16 dev_type = chip->profile;
+	struct xfmc_override *ov;
+	unsigned int i, end, data;
+	int ret = 0;
+
+	lockdep_assert_held(&chip->lock);
+
+	end = xfmc_profile_end(chip, dev_type);
+	if (!end)
+		return -ENODATA;
+
+	regcache_cache_bypass(chip->regmap, true);
+	if (chip->mode) {
+		ret = regmap_read(chip->regmap, chip->mode->addr, &data);
+		if (ret)
+			goto out;
+		if ((data & chip->mode->mask) != chip->mode->val) {
+			dev_dbg(chip->dev, "verify failed, mode %s: %x\n",
+				chip->mode->name, data);
+			ret = -EIO;
+			goto out;
+		}
+	}
+
+	for (i = dev_type; i < end; i++) {
+		if (xfmc_profile_writes(chip, i + 1, end, chip->regs[i].addr))
+			continue;
+
+		ret = xfmc_chip_check(chip, chip->regs[i].addr,
+				      xfmc_profile_val(chip, i, end));
+		if (ret)
+			goto out;
+	}
+
+	list_for_each_entry(ov, &chip->overrides, list) {
+		if (!xfmc_override_extra(chip, ov, dev_type, end))
+			continue;
+
+		ret = xfmc_chip_check(chip, ov->addr, ov->val);
+		if (ret)
+			goto out;
+	}
+out:
+	regcache_cache_bypass(chip->regmap, false);
+	return ret;
+}
+
+/*
+ * Number of writes of @dev_type that change the register value, judged
+ * from the register cache without bus access. Registers that are not
+ * cached count as changed.
+ */
+static unsigned int xfmc_profile_delta(struct xfmc_chip *chip, u16 dev_type,
+				       unsigned int end)
+{
+	struct xfmc_override *ov;
+	unsigned int i, j, data, n = 0;
+	u8 val;
+
+	regcache_cache_only(chip->regmap, true);
+	for (i = dev_type; i < end; i++) {
+		val = xfmc_profile_val(chip, i, end);
+
+		/* An earlier write of the profile sets the value to compare */
+		for (j = i; j > dev_type; j--)
+			if (chip->regs[j - 1].addr == chip->regs[i].addr)
+				break;
+
+		if (j > dev_type)
+			data = xfmc_profile_val(chip, j - 1, end);
+		else if (regmap_read(chip->regmap, chip->regs[i].addr, &data))
+			data = ~val;
+
+		if (data != val)
+			n++;
+	}
+
+	list_for_each_entry(ov, &chip->overrides, list) {
+		if (!xfmc_override_extra(chip, ov, dev_type, end))
+			continue;
+
+		if (regmap_read(chip->regmap, ov->addr, &data) || data != ov->val)
+			n++;
+	}
+	regcache_cache_only(chip->regmap, false);
+
+	return n;
+}
+
+/**
+ * xfmc_chip_apply_req - Program a profile within a latency budget
+ * @chip: chip to program
+ * @dev_type: profile to program
+ * @req: budget and policy, NULL for a full rewrite
+ *
+ * Selects the operating mode of the profile, then writes the entries of
+ * @dev_type in table order. An override replaces the value of the last
+ * write to its register; overrides of registers the profile does not
+ * write are written after the profile. The strategy used, its estimated
+ * and its actual duration are returned in @req.
+ *
+ * Return: 0 for success and error value on failure
+ */
+int xfmc_chip_apply_req(struct xfmc_chip *chip, u16 dev_type,
+			struct xfmc_request *req)
+{
+	unsigned int xfers[XFMC_STRATEGY_VERIFY + 1];
+	unsigned int bytes[XFMC_STRATEGY_VERIFY + 1];
+	u32 cost_us[XFMC_STRATEGY_VERIFY + 1];
+	const struct xfmc_profile *profile;
+	const struct xfmc_mode *mode;
+	struct xfmc_override *ov;
+	unsigned int i, end, n, rmw;
+	ktime_t start;
+	u64 est_ns, ns;
+	u32 strategy;
+	bool delta;
+	int ret = 0;
+
+	end = xfmc_profile_end(chip, dev_type);
+	if (!end)
+		return -EINVAL;
+
+	profile = xfmc_profile_find(chip, dev_type);
+	mode = profile ? profile->mode : NULL;
+
+	mutex_lock(&chip->lock);
+	start = ktime_get();
+
+	n = end - dev_type;
+	list_for_each_entry(ov, &chip->overrides, list)
+		if (xfmc_override_extra(chip, ov, dev_type, end))
+			n++;
+
+	/* The mode update is a read and a write whatever the strategy */
+	rmw = mode ? 1 : 0;
+	i = n;
+	if (req && req->budget_us)
+		i = xfmc_profile_delta(chip, dev_type, end);
+	xfers[XFMC_STRATEGY_DELTA] = 2 * rmw + i;
+	bytes[XFMC_STRATEGY_DELTA] = rmw * (XFMC_READ_BYTES(1) +
+					    XFMC_WRITE_BYTES(1)) +
+				     i * XFMC_WRITE_BYTES(1);
+	xfers[XFMC_STRATEGY_FULL] = 2 * rmw + n;
+	bytes[XFMC_STRATEGY_FULL] = rmw * (XFMC_READ_BYTES(1) +
+					   XFMC_WRITE_BYTES(1)) +
+				    n * XFMC_WRITE_BYTES(1);
+	/* Verify reads back the mode and every register written */
+	xfers[XFMC_STRATEGY_VERIFY] = xfers[XFMC_STRATEGY_FULL] + rmw + n;
+	bytes[XFMC_STRATEGY_VERIFY] = bytes[XFMC_STRATEGY_FULL] +
+				      (rmw + n) * XFMC_READ_BYTES(1);
+	for (i = 0; i <= XFMC_STRATEGY_VERIFY; i++)
+		cost_us[i] = xfmc_cost_us(xfers[i], bytes[i], 0);
+
+	strategy = xfmc_strategy_pick(req, cost_us, XFMC_STRATEGY_VERIFY);
+	delta = strategy == XFMC_STRATEGY_DELTA;
+	est_ns = (u64)cost_us[strategy] * NSEC_PER_USEC;
+
+	if (req && (req->flags & XFMC_REQ_DRY_RUN))
+		goto out;
+
+	if (mode) {
+		ret = regmap_update_bits(chip->regmap, mode->addr, mode->mask,
+					 mode->val);
+		if (ret)
+			goto out;
+	}
+
+	for (i = dev_type; i < end; i++) {
+		ret = xfmc_chip_write(chip, chip->regs[i].addr,
+				      xfmc_profile_val(chip, i, end), delta);
+		if (ret)
+			goto out;
+	}
+
+	list_for_each_entry(ov, &chip->overrides, list) {
+		if (!xfmc_override_extra(chip, ov, dev_type, end))
+			continue;
+
+		ret = xfmc_chip_write(chip, ov->addr, ov->val, delta);
+		if (ret)
+			goto out;
+	}
+
+	/* Recorded together once every write went through */
+	chip->profile = dev_type;
+	if (mode)
+		chip->mode = mode;
+
+	if (strategy == XFMC_STRATEGY_VERIFY)
+		ret = xfmc_chip_verify_locked(chip);
+out:
+	if (ret && chip->failed) {
+		chip->failed_len = xfmc_snapshot_size(chip);
+		if (xfmc_snapshot_locked(chip, chip->failed, chip->failed_len))
+			chip->failed_len = 0;
+	}
+	mutex_unlock(&chip->lock);
+
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	if (req && (req->flags & XFMC_REQ_DRY_RUN)) {
+		req->strategy = strategy;
+		req->estimate_ns = est_ns;
+		req->duration_ns = 0;
+		return 0;
+	}
+
+	xfmc_rec_add(chip->name, xfmc_req_id(req), dev_type, strategy, start,
+		     ret);
+	if (!ret)
+		xfmc_cost_done(XFMC_COST_PROFILE, xfmc_req_id(req),
+			       xfers[strategy], bytes[strategy], 0, est_ns, ns);
+
+	if (req) {
+		req->strategy = strategy;
+		req->estimate_ns = est_ns;
+		req->duration_ns = ns;
+		dev_dbg(chip->dev, "%llx %s: %s in %llu ns, est %llu ns (budget %u us)\n",
+			req->id, xfmc_profile_name(chip, dev_type),
+			xfmc_strategy_name(strategy), req->duration_ns,
+			req->estimate_ns, req->budget_us);
+	}
+
+	return ret;
+}
+
+/**
+ * xfmc_chip_apply - Program a profile from the chip register table
+ * @chip: chip to program
+ * @dev_type: profile to program
+ *
+ * Rewrites the whole profile, see xfmc_chip_apply_req().
+ *
+ * Return: 0 for success and error value on failure
+ */
+int xfmc_chip_apply(struct xfmc_chip *chip, u16 dev_type)
+{
+	return xfmc_chip_apply_req(chip, dev_type, NULL);
+}
+
+static struct xfmc_chip *xfmc_chip_find(const char *name)
+{
+	struct xfmc_chip *chip;
+
+	lockdep_assert_held(&xfmc_chips_lock);
+
+	list_for_each_entry(chip, &xfmc_chips, list)
+		if (!strcmp(chip->name, name))
+			return chip;
+
+	return NULL;
+}
+
+/* Profile name or id, which must start a profile of the register table */
+static int xfmc_profile_parse(struct xfmc_chip *chip, const char *str,
+			      u16 *dev_type)
+{
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < chip->num_profiles; i++) {
+		if (!strcmp(chip->profiles[i].name, str)) {
+			*dev_type = chip->profiles[i].dev_type;
+			return 0;
+		}
+	}
+
+	ret = kstrtou16(str, 0, dev_type);
+	if (ret)
+		return ret;
+
+	return xfmc_profile_end(chip, *dev_type) ? 0 : -EINVAL;
+}
+
+static int xfmc_override_set(struct xfmc_chip *chip, u16 dev_type, u8 addr,
+			     u8 val)
+{
+	struct xfmc_override *ov;
+
+	if (!xfmc_profile_end(chip, dev_type))
+		return -EINVAL;
+
+	mutex_lock(&chip->lock);
+	ov = xfmc_override_find(chip, dev_type, addr);
+	if (!ov) {
+		ov = kzalloc(sizeof(*ov), GFP_KERNEL);
+		if (!ov) {
+			mutex_unlock(&chip->lock);
+			return -ENOMEM;
+		}
+		ov->dev_type = dev_type;
+		ov->addr = addr;
+		list_add_tail(&ov->list, &chip->overrides);
+	}
+	ov->val = val;
+	mutex_unlock(&chip->lock);
+
+	return 0;
+}
+
+static int xfmc_override_del(struct xfmc_chip *chip, u16 dev_type, u8 addr)
+{
+	struct xfmc_override *ov;
+
+	mutex_lock(&chip->lock);
+	ov = xfmc_override_find(chip, dev_type, addr);
+	if (ov) {
+		list_del(&ov->list);
+		kfree(ov);
+	}
+	mutex_unlock(&chip->lock);
+
+	return ov ? 0 : -ENOENT;
+}
+
+static void xfmc_override_clear(struct xfmc_chip *chip)
+{
+	struct xfmc_override *ov, *tmp;
+
+	mutex_lock(&chip->lock);
+	list_for_each_entry_safe(ov, tmp, &chip->overrides, list) {
+		list_del(&ov->list);
+		kfree(ov);
+	}
+	mutex_unlock(&chip->lock);
+}
+
+/**
+ * xfmc_override_update - Add or remove a register override
+ * @name: chip name
+ * @dev_type: profile the override applies to
+ * @addr: register address
+ * @val: register value, ignored when @remove is set
+ * @remove: remove the override instead of adding it
+ *
+ * Return: 0 for success and error value on failure
+ */
+int xfmc_override_update(const char *name, u16 dev_type, u8 addr, u8 val,
+			 bool remove)
+{
+	struct xfmc_chip *chip;
+	int ret;
+
+	mutex_lock(&xfmc_chips_lock);
+	chip = xfmc_chip_find(name);
+	if (!chip)
+		ret = -ENODEV;
+	else if (remove)
+		ret = xfmc_override_del(chip, dev_type, addr);
+	else
+		ret = xfmc_override_set(chip, dev_type, addr, val);
+	mutex_unlock(&xfmc_chips_lock);
+
+	return ret;
+}
+
+/**
+ * xfmc_chip_verify - Read back the applied profile of a chip
+ * @name: chip name
+ *
+ * Compares the final value of every register written by the applied
+ * profile, overrides included, with the value read from the chip.
+ *
+ * Return: 0 if all registers match, -EIO on mismatch, error value on failure
+ */
+int xfmc_chip_verify(const char *name)
+{
+	struct xfmc_chip *chip;
+	int ret;
+
+	mutex_lock(&xfmc_chips_lock);
+	chip = xfmc_chip_find(name);
+	if (chip) {
+		mutex_lock(&chip->lock);
+		ret = xfmc_chip_verify_locked(chip);
+		mutex_unlock(&chip->lock);
+	} else {
+		ret = -ENODEV;
+	}
+	mutex_unlock(&xfmc_chips_lock);
+
+	return ret;
+}
+
+static void xfmc_override_show(struct seq_file *s, struct xfmc_chip *chip,
+			       const char *prefix)
+{
+	struct xfmc_override *ov;
+
+	lockdep_assert_held(&chip->lock);
+
+	list_for_each_entry(ov, &chip->overrides, list)
+		seq_printf(s, "%s%s %s 0x%02x 0x%02x\n", prefix, chip->name,
+			   xfmc_profile_name(chip, ov->dev_type), ov->addr,
+			   ov->val);
+}
+
+static int xfmc_overrides_show(struct seq_file *s, void *unused)
+{
+	struct xfmc_chip *chip;
+
+	mutex_lock(&xfmc_chips_lock);
+	list_for_each_entry(chip, &xfmc_chips, list) {
+		mutex_lock(&chip->lock);
+		xfmc_override_show(s, chip, "");
+		mutex_unlock(&chip->lock);
+	}
+	mutex_unlock(&xfmc_chips_lock);
+
+	return 0;
+}
+
+static int xfmc_overrides_cmd(char *buf)
+{
+	char *argv[5];
+	struct xfmc_chip *chip;
+	u16 dev_type;
+	u8 addr, val;
+	unsigned int argc = 0;
+	char *arg;
+	int ret;
+
+	while ((arg = strsep(&buf, " \t")) && argc < ARRAY_SIZE(argv))
+		if (*arg)
+			argv[argc++] = arg;
+
+	if (argc == 0)
+		return -EINVAL;
+
+	if (!strcmp(argv[0], "clear")) {
+		if (argc > 2)
+			return -EINVAL;
+		list_for_each_entry(chip, &xfmc_chips, list)
+			if (argc == 1 || !strcmp(chip->name, argv[1]))
+				xfmc_override_clear(chip);
+		return 0;
+	}
+
+	if (argc < 4)
+		return -EINVAL;
+
+	chip = xfmc_chip_find(argv[1]);
+	if (!chip)
+		return -ENODEV;
+
+	ret = xfmc_profile_parse(chip, argv[2], &dev_type);
+	if (ret)
+		return ret;
+
+	ret = kstrtou8(argv[3], 0, &addr);
+	if (ret)
+		return ret;
+
+	if (!strcmp(argv[0], "del") && argc == 4)
+		return xfmc_override_del(chip, dev_type, addr);
+
+	if (strcmp(argv[0], "add") || argc != 5)
+		return -EINVAL;
+
+	ret = kstrtou8(argv[4], 0, &val);
+	if (ret)
+		return ret;
+
+	return xfmc_override_set(chip, dev_type, addr, val);
+}
+
+static ssize_t xfmc_overrides_write(struct file *file, const char __user *ubuf,
+				    size_t count, loff_t *ppos)
+{
+	char buf[XFMC_CMD_MAX];
+	int ret;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	mutex_lock(&xfmc_chips_lock);
+	ret = xfmc_overrides_cmd(strim(buf));
+	mutex_unlock(&xfmc_chips_lock);
+
+	return ret ? ret : count;
+}
+
+static int xfmc_overrides_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, xfmc_overrides_show, inode->i_private);
+}
+
+static const struct file_operations xfmc_overrides_fops = {
+	.owner = THIS_MODULE,
+	.open = xfmc_overrides_open,
+	.read = seq_read,
+	.write = xfmc_overrides_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+int xfmc_state_show(struct seq_file *s, void *unused)
+{
+	struct xfmc_chip *chip;
+
+	mutex_lock(&xfmc_chips_lock);
+	list_for_each_entry(chip, &xfmc_chips, list) {
+		mutex_lock(&chip->lock);
+		seq_printf(s, "%s: profile %s mode %s\n", chip->name,
+			   xfmc_profile_name(chip, chip->profile),
+			   chip->mode ? chip->mode->name : "unknown");
+		if (chip->tmds_mbps)
+			seq_printf(s, "  tmds %u changes %u flaps %u held %u\n",
+				   chip->tmds_mbps, chip->tmds_changes,
+				   chip->tmds_flaps, chip->tmds_held);
+		xfmc_override_show(s, chip, "  override ");
+		mutex_unlock(&chip->lock);
+	}
+	mutex_unlock(&xfmc_chips_lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(xfmc_state);
+
+int xfmc_debugfs_init(void)
+{
+	struct xfmc_chip *chip;
+
+	xfmc_debugfs_root = debugfs_create_dir("xfmc", NULL);
+	debugfs_create_file("state", 0444, xfmc_debugfs_root, NULL,
+			    &xfmc_state_fops);
+	debugfs_create_file("overrides", 0644, xfmc_debugfs_root, NULL,
+			    &xfmc_overrides_fops);
+	xfmc_rec_debugfs_init(xfmc_debugfs_root);
+	xfmc_cost_debugfs_init(xfmc_debugfs_root);
+
+	mutex_lock(&xfmc_chips_lock);
+	xfmc_snapshot_dir = debugfs_create_dir("snapshot", xfmc_debugfs_root);
+	list_for_each_entry(chip, &xfmc_chips, list)
+		xfmc_chip_debugfs_init(chip);
+	mutex_unlock(&xfmc_chips_lock);
+
+	return 0;
+}
+
+void xfmc_debugfs_exit(void)
+{
+	/*
+	 * Removing the state file waits for readers holding xfmc_chips_lock,
+	 * so only detach the snapshot directory under the lock.
+	 */
+	mutex_lock(&xfmc_chips_lock);
+	xfmc_snapshot_dir = NULL;
+	mutex_unlock(&xfmc_chips_lock);
+
+	debugfs_remove_recursive(xfmc_debugfs_root);
+	xfmc_debugfs_root = NULL;
+}
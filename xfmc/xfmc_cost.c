@@ -0,0 +1,173 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Xilinx Video FMC bus cost model
+ *
+ * Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Estimates the time of a register sequence on the FMC I2C bus as
+ *
+ *   xfers * xfer_ns + bytes * byte_ns + settle time
+ *
+ * where bytes counts every byte on the wire, device addresses included.
+ * Starting from the figures of a 400 kHz bus, xfer_ns and byte_ns are
+ * fitted to the measured duration of every sequence with a normalized
+ * LMS step, so they follow the actual adapter. Estimate and measurement
+ * of the last operation of each kind are reported in debugfs
+ * (xfmc/cost), with the correlation id of its caller.
+ */
+#include <linux/debugfs.h>
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+
+#include "xfmc.h"
+
+/* 400 kHz: 9 clocks per byte, plus start, stop and driver latency */
+#define XFMC_COST_XFER_NS	15000
+#define XFMC_COST_BYTE_NS	22500
+
+/* Fitted values are kept within these bounds */
+#define XFMC_COST_XFER_MAX_NS	(10 * NSEC_PER_MSEC)
+#define XFMC_COST_BYTE_MIN_NS	100
+#define XFMC_COST_BYTE_MAX_NS	NSEC_PER_MSEC
+
+/* Step size of the fit is 1 / XFMC_COST_STEP */
+#define XFMC_COST_STEP		4
+
+/*
+ * struct xfmc_cost_stat - estimate and measurement of one kind of operation
+ * @count: Operations measured
+ * @id: Correlation id of the last operation, 0 for none
+ * @est_ns: Estimate of the last operation
+ * @meas_ns: Measured duration of the last operation
+ * @abs_err_ns: Sum of the absolute estimation errors
+ */
+struct xfmc_cost_stat {
+	u64 count;
+	u64 id;
+	u64 est_ns;
+	u64 meas_ns;
+	u64 abs_err_ns;
+};
+
+static const char * const xfmc_cost_names[XFMC_COST_NUM] = {
+	[XFMC_COST_PROFILE] = "profile",
+	[XFMC_COST_CLOCK] = "clock",
+	[XFMC_COST_MUX] = "mux",
+	[XFMC_COST_SNAPSHOT] = "snapshot",
+};
+
+static DEFINE_SPINLOCK(xfmc_cost_lock);
+static s64 xfmc_cost_xfer_ns = XFMC_COST_XFER_NS;
+static s64 xfmc_cost_byte_ns = XFMC_COST_BYTE_NS;
+static u64 xfmc_cost_samples;
+static struct xfmc_cost_stat xfmc_cost_stats[XFMC_COST_NUM];
+
+/**
+ * xfmc_cost_est - Estimate the duration of a register sequence
+ * @xfers: number of bus transactions
+ * @bytes: bytes on the bus, see XFMC_WRITE_BYTES() and XFMC_READ_BYTES()
+ * @settle_us: waits of the sequence
+ *
+ * Return: estimated duration in nanoseconds
+ */
+u64 xfmc_cost_est(unsigned int xfers, unsigned int bytes, u32 settle_us)
+{
+	unsigned long flags;
+	u64 ns;
+
+	spin_lock_irqsave(&xfmc_cost_lock, flags);
+	ns = xfers * xfmc_cost_xfer_ns + bytes * xfmc_cost_byte_ns;
+	spin_unlock_irqrestore(&xfmc_cost_lock, flags);
+
+	return ns + (u64)settle_us * NSEC_PER_USEC;
+}
+
+/* Same as xfmc_cost_est(), rounded up to microseconds for the policy */
+u32 xfmc_cost_us(unsigned int xfers, unsigned int bytes, u32 settle_us)
+{
+	return DIV_ROUND_UP_ULL(xfmc_cost_est(xfers, bytes, settle_us),
+				NSEC_PER_USEC);
+}
+
+/**
+ * xfmc_cost_done - Account a measured register sequence
+ * @op: kind of operation
+ * @id: correlation id of the caller, 0 for none
+ * @xfers: number of bus transactions
+ * @bytes: bytes on the bus
+ * @settle_us: waits of the sequence
+ * @est_ns: estimate made before the sequence ran
+ * @ns: measured duration
+ *
+ * Updates the statistics of @op and fits the model to the measurement.
+ */
+void xfmc_cost_done(enum xfmc_cost_op op, u64 id, unsigned int xfers,
+		    unsigned int bytes, u32 settle_us, u64 est_ns, u64 ns)
+{
+	struct xfmc_cost_stat *stat = &xfmc_cost_stats[op];
+	s64 bus_ns, err, norm;
+	unsigned long flags;
+
+	spin_lock_irqsave(&xfmc_cost_lock, flags);
+	stat->count++;
+	stat->id = id;
+	stat->est_ns = est_ns;
+	stat->meas_ns = ns;
+	stat->abs_err_ns += ns > est_ns ? ns - est_ns : est_ns - ns;
+
+	bus_ns = (s64)ns - (s64)settle_us * NSEC_PER_USEC;
+	norm = (s64)xfers * xfers + (s64)bytes * bytes;
+	if (bus_ns > 0 && norm) {
+		err = bus_ns - xfers * xfmc_cost_xfer_ns -
+		      bytes * xfmc_cost_byte_ns;
+		norm *= XFMC_COST_STEP;
+		xfmc_cost_xfer_ns = clamp_t(s64, xfmc_cost_xfer_ns +
+					    div64_s64(err * xfers, norm),
+					    0, XFMC_COST_XFER_MAX_NS);
+		xfmc_cost_byte_ns = clamp_t(s64, xfmc_cost_byte_ns +
+					    div64_s64(err * bytes, norm),
+					    XFMC_COST_BYTE_MIN_NS,
+					    XFMC_COST_BYTE_MAX_NS);
+		xfmc_cost_samples++;
+	}
+	spin_unlock_irqrestore(&xfmc_cost_lock, flags);
+}
+
+static int xfmc_cost_show(struct seq_file *s, void *unused)
+{
+	struct xfmc_cost_stat stats[XFMC_COST_NUM];
+	s64 xfer_ns, byte_ns;
+	unsigned long flags;
+	u64 samples;
+	int i;
+
+	spin_lock_irqsave(&xfmc_cost_lock, flags);
+	xfer_ns = xfmc_cost_xfer_ns;
+	byte_ns = xfmc_cost_byte_ns;
+	samples = xfmc_cost_samples;
+	memcpy(stats, xfmc_cost_stats, sizeof(stats));
+	spin_unlock_irqrestore(&xfmc_cost_lock, flags);
+
+	seq_printf(s, "xfer %lld ns byte %lld ns samples %llu\n",
+		   xfer_ns, byte_ns, samples);
+	for (i = 0; i < XFMC_COST_NUM; i++) {
+		if (!stats[i].count)
+			continue;
+		seq_printf(s, "%s: count %llu last id %llx est %llu us meas %llu us mean err %llu us\n",
+			   xfmc_cost_names[i], stats[i].count, stats[i].id,
+			   div_u64(stats[i].est_ns, NSEC_PER_USEC),
+			   div_u64(stats[i].meas_ns, NSEC_PER_USEC),
+			   div64_u64(stats[i].abs_err_ns,
+				     stats[i].count * NSEC_PER_USEC));
+	}
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(xfmc_cost);
+
+void xfmc_cost_debugfs_init(struct dentry *root)
+{
+	debugfs_create_file("cost", 0444, root, NULL, &xfmc_cost_fops);
+}
@@ -0,0 +1,132 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+/*
+ * Xilinx Video FMC control device interface
+ *
+ * Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * XFMC_IOC_BATCH runs an array of operations on /dev/xfmcN back to back.
+ * Each operation gets its status and duration filled in on return.
+ *
+ * Line rate and clock rate changes take a latency budget and policy
+ * flags. The driver picks the most thorough strategy requested that fits
+ * the budget and reports the one it used, with its estimated and actual
+ * duration. With XFMC_REQ_DRY_RUN only the estimate is made, so callers
+ * can weigh the cost of a change before making it.
+ *
+ * Line rate, mux and clock rate changes carry the correlation id of the
+ * operation into the flight recorder (xfmc/recorder), the cost model
+ * statistics (xfmc/cost) and the debug messages of the driver, so they
+ * can be matched with the events of the caller.
+ *
+ * Register snapshots in debugfs (xfmc/snapshot/<chip>/regs) are a struct
+ * xfmc_snapshot_header followed by num_ranges blocks, each a struct
+ * xfmc_snapshot_range followed by len register values.
+ */
+#ifndef __XFMC_IOCTL_H__
+#define __XFMC_IOCTL_H__
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+#define XFMC_CHIP_NAME_LEN	16
+#define XFMC_BATCH_MAX		1024
+
+enum xfmc_op_code {
+	XFMC_OP_SET_LINERATE = 1,	/* arg.linerate */
+	XFMC_OP_SEL_MUX,		/* arg.mux */
+	XFMC_OP_CLK_RATE,		/* arg.clk, IDT output rate */
+	XFMC_OP_OVERRIDE,		/* arg.reg, register override */
+	XFMC_OP_VERIFY,			/* arg.reg.chip, read back profile */
+};
+
+/* XFMC_OP_OVERRIDE: remove the override instead of adding it */
+#define XFMC_OP_F_REMOVE	(1 << 0)
+/* XFMC_OP_SET_LINERATE, XFMC_OP_CLK_RATE: read back the programmed registers */
+#define XFMC_REQ_VERIFY		(1 << 1)
+/* XFMC_OP_CLK_RATE: read back and wait for the PLL to lock */
+#define XFMC_REQ_WAIT_LOCK	(1 << 2)
+/* XFMC_OP_SET_LINERATE, XFMC_OP_CLK_RATE: estimate only, program nothing */
+#define XFMC_REQ_DRY_RUN	(1 << 3)
+
+/* Reconfiguration strategies, cheapest first */
+enum xfmc_strategy {
+	XFMC_STRATEGY_DELTA,		/* write registers that change only */
+	XFMC_STRATEGY_FULL,		/* rewrite the whole profile */
+	XFMC_STRATEGY_VERIFY,		/* full rewrite and read back */
+	XFMC_STRATEGY_LOCK,		/* full rewrite, read back, PLL lock */
+};
+
+struct xfmc_op {
+	__u32 op;
+	__u32 flags;
+	union {
+		struct {
+			__u64 linerate;
+			__u8 direction;
+			__u8 is_frl;
+			__u8 lanes;
+			__u8 reserved;
+			__u32 budget_us;	/* 0 for no budget */
+		} linerate;
+		struct {
+			__u32 direction;
+			__u32 clk_sel;
+		} mux;
+		struct {
+			__u64 rate;
+			__u32 budget_us;	/* 0 for no budget */
+			__u32 reserved;
+		} clk;
+		struct {
+			char chip[XFMC_CHIP_NAME_LEN];
+			__u16 profile;
+			__u8 addr;
+			__u8 val;
+			__u32 reserved;
+		} reg;
+		__u8 raw[40];
+	} arg;
+	/* filled in by the driver */
+	__s32 status;
+	__u32 strategy;		/* enum xfmc_strategy used */
+	__u64 duration_ns;
+	__u64 estimate_ns;	/* estimated duration of strategy */
+	/* set by the caller */
+	__u64 id;		/* correlation id, 0 for none */
+};
+
+/* Stop at the first operation that fails */
+#define XFMC_BATCH_STOP_ON_ERROR	(1 << 0)
+
+struct xfmc_batch {
+	__u64 ops;		/* pointer to struct xfmc_op[num_ops] */
+	__u32 num_ops;
+	__u32 flags;
+	/* filled in by the driver */
+	__u32 completed;
+	__u32 reserved;
+	__u64 total_ns;
+};
+
+#define XFMC_SNAPSHOT_MAGIC	0x534d4658	/* "XFMS" */
+#define XFMC_SNAPSHOT_VERSION	1
+
+struct xfmc_snapshot_header {
+	__u32 magic;
+	__u16 version;
+	__u16 profile;		/* applied profile, 0xffff if none */
+	char chip[XFMC_CHIP_NAME_LEN];
+	__u64 timestamp_ns;	/* CLOCK_REALTIME */
+	__u32 revision;		/* chip revision, 0 if unknown */
+	__u32 num_ranges;
+};
+
+struct xfmc_snapshot_range {
+	__u16 start;
+	__u16 len;
+};
+
+#define XFMC_IOC_MAGIC	'X'
+#define XFMC_IOC_BATCH	_IOWR(XFMC_IOC_MAGIC, 0x01, struct xfmc_batch)
+
+#endif /* __XFMC_IOCTL_H__ */
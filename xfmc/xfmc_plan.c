@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Xilinx Video FMC reconfiguration planning
+ *
+ * Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+ *
+ */
+#include "xfmc_plan.h"
+
+static const u32 xfmc_tmds_bounds[XFMC_TMDS_BOUNDS] = { 1650, 3400 };
+
+static const char * const xfmc_strategy_names[] = {
+	[XFMC_STRATEGY_DELTA] = "delta",
+	[XFMC_STRATEGY_FULL] = "full",
+	[XFMC_STRATEGY_VERIFY] = "verify",
+	[XFMC_STRATEGY_LOCK] = "lock",
+};
+
+/**
+ * xfmc_rate_classify - Class of a line rate
+ * @is_frl: @mbps is an FRL lane rate
+ * @mbps: line rate in Mbps
+ * @lanes: FRL lanes
+ *
+ * Return: the class, XFMC_RATE_NONE for an FRL rate with no profile
+ */
+enum xfmc_rate_class xfmc_rate_classify(u8 is_frl, u32 mbps, u8 lanes)
+{
+	if (!is_frl)
+		return XFMC_RATE_TMDS_14_L + xfmc_tmds_band(mbps);
+
+	switch (mbps) {
+	case 12000:
+		return XFMC_RATE_FRL_12G;
+	case 10000:
+		return XFMC_RATE_FRL_10G;
+	case 8000:
+		return XFMC_RATE_FRL_8G;
+	case 6000:
+		return lanes == 4 ? XFMC_RATE_FRL_6G_4 : XFMC_RATE_FRL_6G_3;
+	case 3000:
+		return XFMC_RATE_FRL_3G;
+	default:
+		return XFMC_RATE_NONE;
+	}
+}
+
+/* TMDS band of a rate: 0 up to 1650, 1 up to 3400, 2 above */
+u8 xfmc_tmds_band(u32 mbps)
+{
+	return (mbps > xfmc_tmds_bounds[0]) + (mbps > xfmc_tmds_bounds[1]);
+}
+
+/**
+ * xfmc_tmds_hold - Apply band hysteresis to a TMDS line rate
+ * @prev: previous rate returned, 0 if none
+ * @mbps: measured line rate
+ * @margins: hysteresis of each band boundary
+ *
+ * A rate within the margin past a boundary of the band of @prev is moved
+ * back to that boundary, so that it stays in the band of @prev. Any other
+ * rate is returned unchanged.
+ *
+ * Return: the rate to classify the band with
+ */
+u32 xfmc_tmds_hold(u32 prev, u32 mbps, const u32 *margins)
+{
+	const u32 *bounds = xfmc_tmds_bounds;
+	u8 band;
+
+	if (!prev)
+		return mbps;
+
+	band = xfmc_tmds_band(prev);
+	if (band < XFMC_TMDS_BOUNDS && mbps > bounds[band] &&
+	    mbps <= bounds[band] + margins[band])
+		return bounds[band];
+	if (band > 0 && mbps <= bounds[band - 1] &&
+	    mbps + margins[band - 1] > bounds[band - 1])
+		return bounds[band - 1] + 1;
+
+	return mbps;
+}
+
+const char *xfmc_strategy_name(u32 strategy)
+{
+	if (strategy >= ARRAY_SIZE(xfmc_strategy_names))
+		return "unknown";
+
+	return xfmc_strategy_names[strategy];
+}
+
+/**
+ * xfmc_strategy_pick - Pick the reconfiguration strategy of a request
+ * @req: request, NULL for the default full rewrite
+ * @cost_us: estimated cost of each strategy up to @max
+ * @max: most thorough strategy the device supports
+ *
+ * The policy flags select the target strategy. If the target does not
+ * fit the budget, cheaper strategies are tried down to delta-only, which
+ * is used even if it does not fit.
+ *
+ * Return: the strategy to use
+ */
+u32 xfmc_strategy_pick(const struct xfmc_request *req, const u32 *cost_us,
+		       u32 max)
+{
+	u32 strategy = XFMC_STRATEGY_FULL;
+
+	if (!req)
+		return strategy;
+
+	if (req->flags & XFMC_REQ_WAIT_LOCK)
+		strategy = XFMC_STRATEGY_LOCK;
+	else if (req->flags & XFMC_REQ_VERIFY)
+		strategy = XFMC_STRATEGY_VERIFY;
+	strategy = min(strategy, max);
+
+	if (!req->budget_us)
+		return strategy;
+
+	while (strategy > XFMC_STRATEGY_DELTA &&
+	       cost_us[strategy] > req->budget_us)
+		strategy--;
+
+	return strategy;
+}
@@ -0,0 +1,65 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Xilinx Video FMC reconfiguration planning
+ *
+ * Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Line rate classification, TMDS band hysteresis and strategy selection,
+ * without I/O so that they also build in userspace, see xfmc_types.h.
+ */
+#ifndef __XFMC_PLAN_H__
+#define __XFMC_PLAN_H__
+
+#include "xfmc_types.h"
+#include "xfmc_ioctl.h"
+
+/*
+ * struct xfmc_request - reconfiguration policy and result
+ * @id: Correlation id of the caller, 0 for none
+ * @budget_us: Latency budget in microseconds, 0 for none
+ * @flags: XFMC_REQ_* policy flags
+ * @strategy: Strategy used, filled in by the driver
+ * @estimate_ns: Estimated time of @strategy, filled in by the driver
+ * @duration_ns: Time taken, filled in by the driver
+ */
+struct xfmc_request {
+	u64 id;
+	u32 budget_us;
+	u32 flags;
+	u32 strategy;
+	u64 estimate_ns;
+	u64 duration_ns;
+};
+
+/* Correlation id of @req, 0 without a request */
+static inline u64 xfmc_req_id(const struct xfmc_request *req)
+{
+	return req ? req->id : 0;
+}
+
+/* Line rate classes the retimer/redriver profiles are selected by */
+enum xfmc_rate_class {
+	XFMC_RATE_NONE,		/* no profile for the rate */
+	XFMC_RATE_TMDS_14_L,	/* TMDS up to 1650 Mbps */
+	XFMC_RATE_TMDS_14_H,	/* TMDS up to 3400 Mbps */
+	XFMC_RATE_TMDS_20,	/* TMDS above 3400 Mbps */
+	XFMC_RATE_FRL_3G,
+	XFMC_RATE_FRL_6G_3,	/* 6G on 3 lanes */
+	XFMC_RATE_FRL_6G_4,	/* 6G on 4 lanes */
+	XFMC_RATE_FRL_8G,
+	XFMC_RATE_FRL_10G,
+	XFMC_RATE_FRL_12G,
+	XFMC_RATE_NUM,
+};
+
+#define XFMC_TMDS_BOUNDS	2
+
+enum xfmc_rate_class xfmc_rate_classify(u8 is_frl, u32 mbps, u8 lanes);
+u8 xfmc_tmds_band(u32 mbps);
+u32 xfmc_tmds_hold(u32 prev, u32 mbps, const u32 *margins);
+
+const char *xfmc_strategy_name(u32 strategy);
+u32 xfmc_strategy_pick(const struct xfmc_request *req, const u32 *cost_us,
+		       u32 max);
+
+#endif /* __XFMC_PLAN_H__ */
@@ -0,0 +1,146 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Xilinx Video FMC flight recorder
+ *
+ * Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Always records the last XFMC_REC_SIZE high level operations of the card
+ * (line rate and mux changes, clock rates, profiles and probe phases)
+ * with their start time, duration, result and the correlation id of the
+ * caller, if it passed one. Writers claim a slot with
+ * an atomic increment and never block; readers skip slots that are being
+ * rewritten. The ring is read through debugfs (xfmc/recorder) and is
+ * dumped to the kernel log when a mode switch fails.
+ */
+#include <linux/atomic.h>
+#include <linux/debugfs.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/seq_file.h>
+
+#include "xfmc.h"
+
+#define XFMC_REC_SIZE	64	/* power of two */
+#define XFMC_REC_LINE	128
+
+/*
+ * struct xfmc_rec - flight recorder entry
+ * @seq: Sequence number + 1 of the entry, 0 while it is written
+ * @start_ns: Start time, ktime_get() in nanoseconds
+ * @duration_ns: Time taken
+ * @id: Correlation id of the caller, 0 for none
+ * @op: Operation name, static string
+ * @arg: Main argument of the operation (rate, profile, ...)
+ * @aux: Secondary argument of the operation (direction, strategy, ...)
+ * @ret: Result of the operation
+ */
+struct xfmc_rec {
+	unsigned long seq;
+	u64 start_ns;
+	u64 duration_ns;
+	u64 id;
+	const char *op;
+	u64 arg;
+	u32 aux;
+	int ret;
+};
+
+static struct xfmc_rec xfmc_rec_ring[XFMC_REC_SIZE];
+static atomic_long_t xfmc_rec_head = ATOMIC_LONG_INIT(0);
+
+/**
+ * xfmc_rec_add - Record an operation in the flight recorder
+ * @op: operation name, must stay valid while the module is loaded
+ * @id: correlation id of the caller, 0 for none
+ * @arg: main argument of the operation
+ * @aux: secondary argument of the operation
+ * @start: time the operation started
+ * @ret: result of the operation
+ *
+ * Lockless, may be called from any context.
+ */
+void xfmc_rec_add(const char *op, u64 id, u64 arg, u32 aux, ktime_t start,
+		  int ret)
+{
+	unsigned long seq = atomic_long_inc_return(&xfmc_rec_head) - 1;
+	struct xfmc_rec *e = &xfmc_rec_ring[seq & (XFMC_REC_SIZE - 1)];
+
+	WRITE_ONCE(e->seq, 0);
+	smp_wmb();
+	e->start_ns = ktime_to_ns(start);
+	e->duration_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	e->id = id;
+	e->op = op;
+	e->arg = arg;
+	e->aux = aux;
+	e->ret = ret;
+	smp_store_release(&e->seq, seq + 1);
+}
+
+static bool xfmc_rec_get(unsigned long seq, struct xfmc_rec *out)
+{
+	struct xfmc_rec *e = &xfmc_rec_ring[seq & (XFMC_REC_SIZE - 1)];
+
+	if (smp_load_acquire(&e->seq) != seq + 1)
+		return false;
+	*out = *e;
+	smp_rmb();
+
+	return READ_ONCE(e->seq) == seq + 1;
+}
+
+static void xfmc_rec_format(const struct xfmc_rec *e, char *buf, size_t len)
+{
+	snprintf(buf, len, "%5lu %llu.%06llu %8llx %-10s %llu %u: %d in %llu us",
+		 e->seq - 1, e->start_ns / NSEC_PER_SEC,
+		 (e->start_ns % NSEC_PER_SEC) / NSEC_PER_USEC, e->id, e->op,
+		 e->arg, e->aux, e->ret, e->duration_ns / NSEC_PER_USEC);
+}
+
+static void xfmc_rec_for_each(void (*fn)(void *, const char *), void *data)
+{
+	unsigned long head = atomic_long_read(&xfmc_rec_head);
+	unsigned long seq = head > XFMC_REC_SIZE ? head - XFMC_REC_SIZE : 0;
+	char line[XFMC_REC_LINE];
+	struct xfmc_rec e;
+
+	for (; seq < head; seq++) {
+		if (!xfmc_rec_get(seq, &e))
+			continue;
+		xfmc_rec_format(&e, line, sizeof(line));
+		fn(data, line);
+	}
+}
+
+static void xfmc_rec_print(void *data, const char *line)
+{
+	pr_err("xfmc: %s\n", line);
+}
+
+/**
+ * xfmc_rec_dump - Write the flight recorder to the kernel log
+ * @why: reason of the dump
+ */
+void xfmc_rec_dump(const char *why)
+{
+	pr_err("xfmc: %s, last operations:\n", why);
+	xfmc_rec_for_each(xfmc_rec_print, NULL);
+}
+
+static void xfmc_rec_seq(void *data, const char *line)
+{
+	seq_printf(data, "%s\n", line);
+}
+
+static int xfmc_recorder_show(struct seq_file *s, void *unused)
+{
+	xfmc_rec_for_each(xfmc_rec_seq, s);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(xfmc_recorder);
+
+void xfmc_rec_debugfs_init(struct dentry *root)
+{
+	debugfs_create_file("recorder", 0444, root, NULL, &xfmc_recorder_fops);
+}
@@ -0,0 +1,227 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Xilinx Video FMC register snapshots
+ *
+ * Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Dumps the register ranges of a chip straight from the device, one bulk
+ * read per 256 register page, in the binary format of xfmc_ioctl.h. The
+ * register values of a chip always sit at the same offsets, so snapshots
+ * can be compared byte by byte with a golden image past the header.
+ *
+ * xfmc/snapshot/<chip>/regs reads the chip when it is opened,
+ * xfmc/snapshot/<chip>/failed returns the snapshot taken when a profile
+ * change of the chip last failed.
+ */
+#include <linux/fs.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/lockdep.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include "xfmc.h"
+
+#define XFMC_SNAPSHOT_PAGE	256
+
+static unsigned int xfmc_snapshot_len(const struct regmap_range *range)
+{
+	return range->range_max - range->range_min + 1;
+}
+
+/* Bulk reads of a snapshot, one per page of each range */
+static unsigned int xfmc_snapshot_xfers(struct xfmc_chip *chip)
+{
+	unsigned int i, first, last, xfers = 0;
+
+	for (i = 0; i < chip->num_dump; i++) {
+		first = chip->dump[i].range_min / XFMC_SNAPSHOT_PAGE;
+		last = chip->dump[i].range_max / XFMC_SNAPSHOT_PAGE;
+		xfers += last - first + 1;
+	}
+
+	return xfers;
+}
+
+/* Bus bytes of reading the snapshot ranges with @xfers bulk reads */
+static unsigned int xfmc_snapshot_bytes(struct xfmc_chip *chip,
+					unsigned int xfers)
+{
+	unsigned int i, regs = 0;
+
+	for (i = 0; i < chip->num_dump; i++)
+		regs += xfmc_snapshot_len(&chip->dump[i]);
+
+	return xfers * XFMC_READ_BYTES(1) + regs - xfers;
+}
+
+/**
+ * xfmc_snapshot_size - Size of a register snapshot of a chip
+ * @chip: chip to dump
+ *
+ * Return: size in bytes, 0 if the chip has no register ranges
+ */
+size_t xfmc_snapshot_size(struct xfmc_chip *chip)
+{
+	size_t size;
+	unsigned int i;
+
+	if (!chip->num_dump)
+		return 0;
+
+	size = sizeof(struct xfmc_snapshot_header);
+	for (i = 0; i < chip->num_dump; i++)
+		size += sizeof(struct xfmc_snapshot_range) +
+			xfmc_snapshot_len(&chip->dump[i]);
+
+	return size;
+}
+
+/**
+ * xfmc_snapshot_locked - Take a register snapshot of a chip
+ * @chip: chip to dump, with its lock held
+ * @buf: buffer of xfmc_snapshot_size() bytes
+ * @len: size of @buf
+ *
+ * Registers are read from the device, bypassing the register cache.
+ *
+ * Return: 0 for success and error value on failure
+ */
+int xfmc_snapshot_locked(struct xfmc_chip *chip, void *buf, size_t len)
+{
+	struct xfmc_snapshot_header *hdr = buf;
+	struct xfmc_snapshot_range *rng;
+	unsigned int i, reg, end, n, xfers;
+	u8 *p = buf;
+	ktime_t start;
+	u64 est_ns;
+	int ret = 0;
+
+	lockdep_assert_held(&chip->lock);
+
+	if (!len || len != xfmc_snapshot_size(chip))
+		return -EINVAL;
+
+	memset(hdr, 0, sizeof(*hdr));
+	hdr->magic = XFMC_SNAPSHOT_MAGIC;
+	hdr->version = XFMC_SNAPSHOT_VERSION;
+	hdr->profile = chip->profile;
+	strscpy(hdr->chip, chip->name, sizeof(hdr->chip));
+	hdr->timestamp_ns = ktime_to_ns(ktime_get_real());
+	hdr->revision = chip->revision;
+	hdr->num_ranges = chip->num_dump;
+	p += sizeof(*hdr);
+
+	xfers = xfmc_snapshot_xfers(chip);
+	est_ns = xfmc_cost_est(xfers, xfmc_snapshot_bytes(chip, xfers), 0);
+	start = ktime_get();
+
+	regcache_cache_bypass(chip->regmap, true);
+	for (i = 0; i < chip->num_dump; i++) {
+		rng = (struct xfmc_snapshot_range *)p;
+		rng->start = chip->dump[i].range_min;
+		rng->len = xfmc_snapshot_len(&chip->dump[i]);
+		p += sizeof(*rng);
+
+		end = chip->dump[i].range_max + 1;
+		for (reg = chip->dump[i].range_min; reg < end; reg += n) {
+			/* Paged chips can't read across a page boundary */
+			n = min(end - reg, XFMC_SNAPSHOT_PAGE -
+				reg % XFMC_SNAPSHOT_PAGE);
+			ret = regmap_bulk_read(chip->regmap, reg, p, n);
+			if (ret)
+				goto out;
+			p += n;
+		}
+	}
+out:
+	regcache_cache_bypass(chip->regmap, false);
+	if (!ret)
+		xfmc_cost_done(XFMC_COST_SNAPSHOT, 0, xfers,
+			       xfmc_snapshot_bytes(chip, xfers), 0, est_ns,
+			       ktime_to_ns(ktime_sub(ktime_get(), start)));
+	return ret;
+}
+
+struct xfmc_snapshot_buf {
+	size_t len;
+	u8 data[];
+};
+
+static int xfmc_snapshot_open(struct inode *inode, struct file *file)
+{
+	struct xfmc_chip *chip = inode->i_private;
+	struct xfmc_snapshot_buf *snap;
+	size_t len = xfmc_snapshot_size(chip);
+	int ret;
+
+	snap = kvmalloc(struct_size(snap, data, len), GFP_KERNEL);
+	if (!snap)
+		return -ENOMEM;
+
+	mutex_lock(&chip->lock);
+	ret = xfmc_snapshot_locked(chip, snap->data, len);
+	mutex_unlock(&chip->lock);
+	if (ret) {
+		kvfree(snap);
+		return ret;
+	}
+
+	snap->len = len;
+	file->private_data = snap;
+
+	return 0;
+}
+
+static int xfmc_snapshot_failed_open(struct inode *inode, struct file *file)
+{
+	struct xfmc_chip *chip = inode->i_private;
+	struct xfmc_snapshot_buf *snap;
+	size_t len = xfmc_snapshot_size(chip);
+
+	snap = kvmalloc(struct_size(snap, data, len), GFP_KERNEL);
+	if (!snap)
+		return -ENOMEM;
+
+	mutex_lock(&chip->lock);
+	snap->len = chip->failed_len;
+	memcpy(snap->data, chip->failed, snap->len);
+	mutex_unlock(&chip->lock);
+
+	file->private_data = snap;
+
+	return 0;
+}
+
+static ssize_t xfmc_snapshot_read(struct file *file, char __user *ubuf,
+				  size_t count, loff_t *ppos)
+{
+	struct xfmc_snapshot_buf *snap = file->private_data;
+
+	return simple_read_from_buffer(ubuf, count, ppos, snap->data,
+				       snap->len);
+}
+
+static int xfmc_snapshot_release(struct inode *inode, struct file *file)
+{
+	kvfree(file->private_data);
+
+	return 0;
+}
+
+const struct file_operations xfmc_snapshot_fops = {
+	.owner = THIS_MODULE,
+	.open = xfmc_snapshot_open,
+	.read = xfmc_snapshot_read,
+	.llseek = default_llseek,
+	.release = xfmc_snapshot_release,
+};
+
+const struct file_operations xfmc_snapshot_failed_fops = {
+	.owner = THIS_MODULE,
+	.open = xfmc_snapshot_failed_open,
+	.read = xfmc_snapshot_read,
+	.llseek = default_llseek,
+	.release = xfmc_snapshot_release,
+};
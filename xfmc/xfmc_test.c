@@ -0,0 +1,608 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Xilinx Video FMC KUnit tests
+ *
+ * Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * Tests the kernel-agnostic units (line rate classification, TMDS
+ * hysteresis, strategy selection and the IDT solver) and stresses
+ * profile changes and register overrides of a chip on a simulated bus
+ * from concurrent workers. The mux read-modify-write is tested in
+ * fmc64_test.c, the entry points of the HDMI subsystem in x_vfmc_test.c.
+ */
+#include <kunit/device.h>
+#include <kunit/test.h>
+#include <linux/atomic.h>
+#include <linux/delay.h>
+#include <linux/regmap.h>
+#include <linux/workqueue.h>
+
+#include "idt_calc.h"
+#include "xfmc.h"
+
+#define XFMC_TEST_WORKERS	8
+#define XFMC_TEST_LOOPS		50
+#define XFMC_TEST_REGS		0x20
+#define XFMC_TEST_XTAL		40000000
+
+/* Profile ids are the index of their first table entry */
+#define XFMC_TEST_A		0
+#define XFMC_TEST_B		4
+
+static const struct reg_fields xfmc_test_regs[] = {
+	{ XFMC_TEST_A, 0x01, 0x11 },
+	{ XFMC_TEST_A, 0x02, 0x12 },
+	{ XFMC_TEST_A, 0x03, 0x13 },
+	{ XFMC_TEST_A, 0x01, 0x14 },
+	{ XFMC_TEST_B, 0x01, 0x21 },
+	{ XFMC_TEST_B, 0x02, 0x22 },
+	{ XFMC_TEST_B, 0x04, 0x24 },
+	{ XFMC_TEST_B, 0x05, 0x25 },
+};
+
+static const struct xfmc_mode xfmc_test_mode_a = { "a", 0x10, 0xC0, 0x40 };
+static const struct xfmc_mode xfmc_test_mode_b = { "b", 0x10, 0xC0, 0x80 };
+
+static const struct xfmc_profile xfmc_test_profiles[] = {
+	{ XFMC_TEST_A, "A", &xfmc_test_mode_a },
+	{ XFMC_TEST_B, "B", &xfmc_test_mode_b },
+};
+
+static void xfmc_test_rate_classify(struct kunit *test)
+{
+	static const struct {
+		u8 is_frl;
+		u32 mbps;
+		u8 lanes;
+		enum xfmc_rate_class class;
+	} cases[] = {
+		{ 0, 250, 4, XFMC_RATE_TMDS_14_L },
+		{ 0, 1650, 4, XFMC_RATE_TMDS_14_L },
+		{ 0, 1651, 4, XFMC_RATE_TMDS_14_H },
+		{ 0, 3400, 4, XFMC_RATE_TMDS_14_H },
+		{ 0, 3401, 4, XFMC_RATE_TMDS_20 },
+		{ 0, 6000, 4, XFMC_RATE_TMDS_20 },
+		{ 1, 3000, 3, XFMC_RATE_FRL_3G },
+		{ 1, 6000, 3, XFMC_RATE_FRL_6G_3 },
+		{ 1, 6000, 4, XFMC_RATE_FRL_6G_4 },
+		{ 1, 8000, 4, XFMC_RATE_FRL_8G },
+		{ 1, 10000, 4, XFMC_RATE_FRL_10G },
+		{ 1, 12000, 4, XFMC_RATE_FRL_12G },
+		{ 1, 7000, 4, XFMC_RATE_NONE },
+	};
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(cases); i++)
+		KUNIT_EXPECT_EQ_MSG(test, xfmc_rate_classify(cases[i].is_frl,
+							     cases[i].mbps,
+							     cases[i].lanes),
+				    cases[i].class, "frl %u %u Mbps %u lanes",
+				    cases[i].is_frl, cases[i].mbps,
+				    cases[i].lanes);
+}
+
+static void xfmc_test_tmds_hold(struct kunit *test)
+{
+	static const u32 margins[XFMC_TMDS_BOUNDS] = { 20, 20 };
+	static const struct {
+		u32 prev;
+		u32 mbps;
+		u32 rate;
+	} cases[] = {
+		{ 0, 1660, 1660 },	/* nothing to hold */
+		{ 1600, 1660, 1650 },	/* held below 1650 */
+		{ 1600, 1671, 1671 },	/* past the margin */
+		{ 1700, 1640, 1651 },	/* held above 1650 */
+		{ 1700, 1630, 1630 },
+		{ 3000, 3410, 3400 },	/* held below 3400 */
+		{ 3500, 3390, 3401 },	/* held above 3400 */
+		{ 1600, 3410, 3410 },	/* past a boundary of another band */
+		{ 1600, 3430, 3430 },
+		{ 5000, 1640, 1640 },
+	};
+	unsigned int i;
+	u32 rate;
+
+	for (i = 0; i < ARRAY_SIZE(cases); i++) {
+		rate = xfmc_tmds_hold(cases[i].prev, cases[i].mbps, margins);
+		KUNIT_EXPECT_EQ_MSG(test, rate, cases[i].rate, "%u -> %u Mbps",
+				    cases[i].prev, cases[i].mbps);
+		if (cases[i].prev && rate != cases[i].mbps)
+			KUNIT_EXPECT_EQ(test, xfmc_tmds_band(rate),
+					xfmc_tmds_band(cases[i].prev));
+	}
+}
+
+static void xfmc_test_strategy_pick(struct kunit *test)
+{
+	static const u32 cost_us[XFMC_STRATEGY_LOCK + 1] = {
+		100, 400, 900, 5000
+	};
+	static const struct {
+		u32 flags;
+		u32 budget_us;
+		u32 max;
+		u32 strategy;
+	} cases[] = {
+		{ 0, 0, XFMC_STRATEGY_LOCK, XFMC_STRATEGY_FULL },
+		{ XFMC_REQ_VERIFY, 0, XFMC_STRATEGY_LOCK, XFMC_STRATEGY_VERIFY },
+		{ XFMC_REQ_WAIT_LOCK, 0, XFMC_STRATEGY_LOCK, XFMC_STRATEGY_LOCK },
+		{ XFMC_REQ_WAIT_LOCK, 0, XFMC_STRATEGY_VERIFY,
+		  XFMC_STRATEGY_VERIFY },
+		{ XFMC_REQ_WAIT_LOCK, 1000, XFMC_STRATEGY_LOCK,
+		  XFMC_STRATEGY_VERIFY },
+		{ XFMC_REQ_VERIFY, 500, XFMC_STRATEGY_LOCK, XFMC_STRATEGY_FULL },
+		{ 0, 200, XFMC_STRATEGY_LOCK, XFMC_STRATEGY_DELTA },
+		/* delta-only is used even when it does not fit */
+		{ XFMC_REQ_WAIT_LOCK, 50, XFMC_STRATEGY_LOCK,
+		  XFMC_STRATEGY_DELTA },
+	};
+	struct xfmc_request req = { 0 };
+	unsigned int i;
+
+	KUNIT_EXPECT_EQ(test, xfmc_strategy_pick(NULL, cost_us,
+						 XFMC_STRATEGY_LOCK),
+			XFMC_STRATEGY_FULL);
+
+	for (i = 0; i < ARRAY_SIZE(cases); i++) {
+		req.flags = cases[i].flags;
+		req.budget_us = cases[i].budget_us;
+		KUNIT_EXPECT_EQ_MSG(test, xfmc_strategy_pick(&req, cost_us,
+							     cases[i].max),
+				    cases[i].strategy, "case %u", i);
+	}
+}
+
+static struct kunit_case xfmc_plan_test_cases[] = {
+	KUNIT_CASE(xfmc_test_rate_classify),
+	KUNIT_CASE(xfmc_test_tmds_hold),
+	KUNIT_CASE(xfmc_test_strategy_pick),
+	{}
+};
+
+static struct kunit_suite xfmc_plan_test_suite = {
+	.name = "xfmc-plan",
+	.test_cases = xfmc_plan_test_cases,
+};
+
+/* Checks the loops of the synthesizer settings of @fout */
+static void xfmc_test_idt_check(struct kunit *test, u32 fout)
+{
+	const u64 xtal2 = 2ULL * XFMC_TEST_XTAL;
+	struct idt_settings s = { 0 };
+	u64 fvco, upper;
+
+	KUNIT_ASSERT_EQ(test, idt_cal_settings(XFMC_TEST_XTAL, XFMC_TEST_XTAL,
+					       fout, &s), 0);
+
+	/* Output divider 2 * (N + NFRAC / 2^28), NFRAC is 0 or one half */
+	fvco = (u64)fout * (2 * s.n_qx - (s.nfrac_qx ? 1 : 0));
+	KUNIT_EXPECT_GE_MSG(test, fvco, IDT_8T49N24X_FVCO_MIN, "%u Hz", fout);
+	KUNIT_EXPECT_LE_MSG(test, fvco, IDT_8T49N24X_FVCO_MAX, "%u Hz", fout);
+
+	/* Upper loop: 2 * xtal * (DSM_INT + DSM_FRAC / 2^21) */
+	upper = xtal2 * s.dsm_int + ((xtal2 * s.dsm_frac) >> 21);
+	KUNIT_EXPECT_LE_MSG(test, abs_diff(upper, fvco), (xtal2 >> 21) + 1,
+			    "%u Hz", fout);
+
+	/* Lower loop: M1 / PRE is the rounded VCO to input ratio */
+	KUNIT_EXPECT_LE_MSG(test, abs_diff((u64)s.m1_x * XFMC_TEST_XTAL,
+					   fvco * s.pre_x),
+			    (u64)XFMC_TEST_XTAL / 2, "%u Hz", fout);
+
+	KUNIT_EXPECT_GE(test, s.los_x, 6);
+}
+
+static void xfmc_test_idt_settings(struct kunit *test)
+{
+	static const u32 rates[] = {
+		25175000, 27000000, 74250000, 148500000, 296703000, 297000000,
+	};
+	static const u8 bpc_x4[] = { 4, 5, 6, 8 };
+	unsigned int i, j;
+	u32 fout;
+
+	for (i = 0; i < ARRAY_SIZE(rates); i++) {
+		for (j = 0; j < ARRAY_SIZE(bpc_x4); j++) {
+			fout = rates[i] / 4 * bpc_x4[j];
+			if (fout <= IDT_8T49N24X_FOUT_MAX)
+				xfmc_test_idt_check(test, fout);
+		}
+	}
+}
+
+static void xfmc_test_idt_delta(struct kunit *test)
+{
+	struct idt_settings old[2] = { 0 }, new[2];
+
+	KUNIT_ASSERT_EQ(test, idt_cal_settings(XFMC_TEST_XTAL, XFMC_TEST_XTAL,
+					       148500000, &old[0]), 0);
+	old[1] = old[0];
+	memcpy(new, old, sizeof(new));
+	KUNIT_EXPECT_EQ(test, idt_settings_delta(old, new), 0);
+
+	/* One DSM_FRAC byte */
+	new[0].dsm_frac ^= 0xff;
+	KUNIT_EXPECT_EQ(test, idt_settings_delta(old, new), 1);
+
+	/* N_Q is written for outputs 2 and 3 */
+	new[0].n_qx ^= 1;
+	KUNIT_EXPECT_EQ(test, idt_settings_delta(old, new), 3);
+
+	/* The pre-divider of the second input */
+	new[1].pre_x ^= 0x10000;
+	KUNIT_EXPECT_EQ(test, idt_settings_delta(old, new), 4);
+}
+
+static struct kunit_case xfmc_idt_calc_test_cases[] = {
+	KUNIT_CASE(xfmc_test_idt_settings),
+	KUNIT_CASE(xfmc_test_idt_delta),
+	{}
+};
+
+static struct kunit_suite xfmc_idt_calc_test_suite = {
+	.name = "xfmc-idt-calc",
+	.test_cases = xfmc_idt_calc_test_cases,
+};
+
+/*
+ * struct xfmc_test_bus - chip on a simulated bus
+ * @test: Running test
+ * @chip: Chip registered with the FMC core
+ * @regs: Register values of the device
+ * @writes: Register writes that reached the device
+ * @fail_reg: Register whose writes fail, -1 for none
+ */
+struct xfmc_test_bus {
+	struct kunit *test;
+	struct xfmc_chip chip;
+	u8 regs[XFMC_TEST_REGS];
+	atomic_t writes;
+	int fail_reg;
+};
+
+static int xfmc_test_reg_write(void *context, unsigned int reg,
+			       unsigned int val)
+{
+	struct xfmc_test_bus *bus = context;
+
+	/* Register sequences of the core never interleave */
+	KUNIT_EXPECT_TRUE(bus->test, mutex_is_locked(&bus->chip.lock));
+
+	if (reg == READ_ONCE(bus->fail_reg))
+		return -EIO;
+
+	bus->regs[reg] = val;
+	atomic_inc(&bus->writes);
+
+	/* Leave other workers time to get in between */
+	usleep_range(5, 10);
+
+	return 0;
+}
+
+static int xfmc_test_reg_read(void *context, unsigned int reg,
+			      unsigned int *val)
+{
+	struct xfmc_test_bus *bus = context;
+
+	*val = bus->regs[reg];
+
+	return 0;
+}
+
+static const struct regmap_config xfmc_test_regmap_config = {
+	.reg_bits = 8,
+	.val_bits = 8,
+	.max_register = XFMC_TEST_REGS - 1,
+	.cache_type = REGCACHE_RBTREE,
+	.reg_read = xfmc_test_reg_read,
+	.reg_write = xfmc_test_reg_write,
+};
+
+static int xfmc_core_test_init(struct kunit *test)
+{
+	struct xfmc_test_bus *bus;
+	struct device *dev;
+
+	/* Allocated first, the device and its chip are released before */
+	bus = kunit_kzalloc(test, sizeof(*bus), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, bus);
+
+	dev = kunit_device_register(test, "xfmc-test");
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, dev);
+
+	bus->test = test;
+	bus->fail_reg = -1;
+	bus->chip.name = "xfmc-test";
+	bus->chip.dev = dev;
+	bus->chip.regmap = devm_regmap_init(dev, NULL, bus,
+					    &xfmc_test_regmap_config);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, bus->chip.regmap);
+	bus->chip.regs = xfmc_test_regs;
+	bus->chip.num_regs = ARRAY_SIZE(xfmc_test_regs);
+	bus->chip.profiles = xfmc_test_profiles;
+	bus->chip.num_profiles = ARRAY_SIZE(xfmc_test_profiles);
+	KUNIT_ASSERT_EQ(test, xfmc_chip_register(&bus->chip), 0);
+
+	test->priv = bus;
+
+	return 0;
+}
+
+/* Compares the device with the table values of @dev_type */
+static void xfmc_test_expect_profile(struct kunit *test,
+				     struct xfmc_test_bus *bus, u16 dev_type)
+{
+	const struct xfmc_mode *mode = NULL;
+	int expect[XFMC_TEST_REGS];
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(expect); i++)
+		expect[i] = -1;
+
+	for (i = dev_type; i < ARRAY_SIZE(xfmc_test_regs); i++) {
+		if (xfmc_test_regs[i].dev_type != dev_type)
+			break;
+		expect[xfmc_test_regs[i].addr] = xfmc_test_regs[i].val;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(xfmc_test_profiles); i++)
+		if (xfmc_test_profiles[i].dev_type == dev_type)
+			mode = xfmc_test_profiles[i].mode;
+
+	for (i = 0; i < ARRAY_SIZE(expect); i++)
+		if (expect[i] >= 0)
+			KUNIT_EXPECT_EQ_MSG(test, bus->regs[i], expect[i],
+					    "reg %#x", i);
+
+	KUNIT_ASSERT_NOT_NULL(test, mode);
+	KUNIT_EXPECT_EQ(test, bus->regs[mode->addr] & mode->mask, mode->val);
+}
+
+/*
+ * struct xfmc_test_worker - concurrent user of the test chip
+ * @work: Work running the worker
+ * @bus: Test chip
+ * @id: Worker index
+ * @ret: First error of the worker
+ */
+struct xfmc_test_worker {
+	struct work_struct work;
+	struct xfmc_test_bus *bus;
+	unsigned int id;
+	int ret;
+};
+
+static struct xfmc_test_worker *xfmc_test_workers(struct kunit *test,
+						  work_func_t apply,
+						  work_func_t other)
+{
+	struct xfmc_test_bus *bus = test->priv;
+	struct xfmc_test_worker *w;
+	unsigned int i;
+
+	w = kunit_kcalloc(test, XFMC_TEST_WORKERS, sizeof(*w), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, w);
+
+	for (i = 0; i < XFMC_TEST_WORKERS; i++) {
+		w[i].bus = bus;
+		w[i].id = i;
+		INIT_WORK(&w[i].work, other && (i & 1) ? other : apply);
+	}
+
+	return w;
+}
+
+/* Runs all workers at once and waits for them */
+static void xfmc_test_run(struct kunit *test, struct xfmc_test_worker *w)
+{
+	struct workqueue_struct *wq;
+	unsigned int i;
+
+	wq = alloc_workqueue("xfmc-test", WQ_UNBOUND, XFMC_TEST_WORKERS);
+	KUNIT_ASSERT_NOT_NULL(test, wq);
+
+	for (i = 0; i < XFMC_TEST_WORKERS; i++)
+		queue_work(wq, &w[i].work);
+
+	destroy_workqueue(wq);
+
+	for (i = 0; i < XFMC_TEST_WORKERS; i++)
+		KUNIT_EXPECT_EQ_MSG(test, w[i].ret, 0, "worker %u", i);
+}
+
+/* Alternates profiles and full, verified and delta-only strategies */
+static void xfmc_test_apply_work(struct work_struct *work)
+{
+	struct xfmc_test_worker *w = container_of(work,
+						  struct xfmc_test_worker,
+						  work);
+	struct xfmc_request req = { 0 };
+	unsigned int i, n;
+
+	for (i = 0; i < XFMC_TEST_LOOPS && !w->ret; i++) {
+		n = w->id + i;
+		req.flags = n % 3 == 1 ? XFMC_REQ_VERIFY : 0;
+		req.budget_us = n % 3 == 2 ? 1 : 0;
+		w->ret = xfmc_chip_apply_req(&w->bus->chip,
+					     n & 1 ? XFMC_TEST_B : XFMC_TEST_A,
+					     &req);
+	}
+}
+
+/* Profile A only, against concurrent override changes */
+static void xfmc_test_apply_a_work(struct work_struct *work)
+{
+	struct xfmc_test_worker *w = container_of(work,
+						  struct xfmc_test_worker,
+						  work);
+	struct xfmc_request req = { 0 };
+	unsigned int i;
+
+	for (i = 0; i < XFMC_TEST_LOOPS && !w->ret; i++) {
+		req.budget_us = i & 1;
+		w->ret = xfmc_chip_apply_req(&w->bus->chip, XFMC_TEST_A, &req);
+	}
+}
+
+/* Adds and removes an override, of a register of A for worker 1 */
+static void xfmc_test_override_work(struct work_struct *work)
+{
+	struct xfmc_test_worker *w = container_of(work,
+						  struct xfmc_test_worker,
+						  work);
+	const char *name = w->bus->chip.name;
+	u8 addr = w->id == 1 ? 0x03 : 0x05 + w->id;
+	unsigned int i;
+
+	for (i = 0; i < XFMC_TEST_LOOPS && !w->ret; i++) {
+		w->ret = xfmc_override_update(name, XFMC_TEST_A, addr,
+					      0x30 + i, false);
+		if (!w->ret)
+			w->ret = xfmc_override_update(name, XFMC_TEST_A, addr,
+						      0, true);
+	}
+}
+
+static void xfmc_test_apply_stress(struct kunit *test)
+{
+	struct xfmc_test_bus *bus = test->priv;
+	struct xfmc_test_worker *w;
+
+	w = xfmc_test_workers(test, xfmc_test_apply_work, NULL);
+	xfmc_test_run(test, w);
+
+	KUNIT_ASSERT_NE(test, bus->chip.profile, XFMC_PROFILE_NONE);
+	xfmc_test_expect_profile(test, bus, bus->chip.profile);
+	KUNIT_EXPECT_EQ(test, xfmc_chip_verify(bus->chip.name), 0);
+}
+
+static void xfmc_test_override_stress(struct kunit *test)
+{
+	struct xfmc_test_bus *bus = test->priv;
+	struct xfmc_test_worker *w;
+
+	w = xfmc_test_workers(test, xfmc_test_apply_a_work,
+			      xfmc_test_override_work);
+	xfmc_test_run(test, w);
+
+	/* All overrides are gone, a full rewrite restores the table */
+	KUNIT_ASSERT_EQ(test, xfmc_chip_apply(&bus->chip, XFMC_TEST_A), 0);
+	xfmc_test_expect_profile(test, bus, XFMC_TEST_A);
+	KUNIT_EXPECT_EQ(test, xfmc_chip_verify(bus->chip.name), 0);
+}
+
+static void xfmc_test_override_invalid(struct kunit *test)
+{
+	struct xfmc_test_bus *bus = test->priv;
+	const char *name = bus->chip.name;
+
+	/* Inside profile A, past the table and no profile at all */
+	KUNIT_EXPECT_EQ(test, xfmc_override_update(name, 1, 0x01, 0, false),
+			-EINVAL);
+	KUNIT_EXPECT_EQ(test, xfmc_override_update(name, 100, 0x01, 0, false),
+			-EINVAL);
+	KUNIT_EXPECT_EQ(test, xfmc_override_update(name, XFMC_PROFILE_NONE,
+						   0x01, 0, false), -EINVAL);
+	KUNIT_EXPECT_EQ(test, xfmc_override_update(name, XFMC_TEST_B, 0x01, 0,
+						   true), -ENOENT);
+	KUNIT_EXPECT_EQ(test, xfmc_override_update("xfmc-none", XFMC_TEST_B,
+						   0x01, 0, false), -ENODEV);
+}
+
+static void xfmc_test_apply_delta(struct kunit *test)
+{
+	struct xfmc_test_bus *bus = test->priv;
+	struct xfmc_request req = { .budget_us = 1 };
+	int writes;
+
+	KUNIT_ASSERT_EQ(test, xfmc_chip_apply(&bus->chip, XFMC_TEST_A), 0);
+
+	/* Nothing changes, delta-only writes nothing */
+	writes = atomic_read(&bus->writes);
+	KUNIT_EXPECT_EQ(test, xfmc_chip_apply_req(&bus->chip, XFMC_TEST_A,
+						  &req), 0);
+	KUNIT_EXPECT_EQ(test, req.strategy, XFMC_STRATEGY_DELTA);
+	KUNIT_EXPECT_EQ(test, atomic_read(&bus->writes), writes);
+
+	/* Dry run estimates and writes nothing */
+	req.budget_us = 0;
+	req.flags = XFMC_REQ_DRY_RUN;
+	KUNIT_EXPECT_EQ(test, xfmc_chip_apply_req(&bus->chip, XFMC_TEST_B,
+						  &req), 0);
+	KUNIT_EXPECT_EQ(test, req.strategy, XFMC_STRATEGY_FULL);
+	KUNIT_EXPECT_GT(test, req.estimate_ns, 0);
+	KUNIT_EXPECT_EQ(test, atomic_read(&bus->writes), writes);
+	KUNIT_EXPECT_EQ(test, bus->chip.profile, XFMC_TEST_A);
+}
+
+static void xfmc_test_apply_error(struct kunit *test)
+{
+	struct xfmc_test_bus *bus = test->priv;
+
+	KUNIT_EXPECT_EQ(test, xfmc_chip_apply(&bus->chip, 1), -EINVAL);
+
+	KUNIT_ASSERT_EQ(test, xfmc_chip_apply(&bus->chip, XFMC_TEST_A), 0);
+
+	/* A failed profile change keeps the profile and takes a snapshot */
+	WRITE_ONCE(bus->fail_reg, 0x02);
+	KUNIT_EXPECT_EQ(test, xfmc_chip_apply(&bus->chip, XFMC_TEST_B), -EIO);
+	KUNIT_EXPECT_EQ(test, bus->chip.profile, XFMC_TEST_A);
+	KUNIT_EXPECT_PTR_EQ(test, bus->chip.mode, &xfmc_test_mode_a);
+	KUNIT_EXPECT_GT(test, bus->chip.failed_len, 0);
+	KUNIT_EXPECT_EQ(test, bus->chip.failed_len,
+			xfmc_snapshot_size(&bus->chip));
+
+	WRITE_ONCE(bus->fail_reg, -1);
+	KUNIT_EXPECT_EQ(test, xfmc_chip_apply(&bus->chip, XFMC_TEST_B), 0);
+	xfmc_test_expect_profile(test, bus, XFMC_TEST_B);
+	KUNIT_EXPECT_EQ(test, xfmc_chip_verify(bus->chip.name), 0);
+}
+
+static void xfmc_test_tmds_commit(struct kunit *test)
+{
+	struct xfmc_test_bus *bus = test->priv;
+	struct xfmc_request dry = { .flags = XFMC_REQ_DRY_RUN };
+	u32 rate;
+
+	/* The rate is only recorded by the commit after the apply */
+	rate = xfmc_tmds_rate(&bus->chip, 1600, NULL);
+	KUNIT_EXPECT_EQ(test, rate, 1600);
+	KUNIT_EXPECT_EQ(test, bus->chip.tmds_mbps, 0);
+	xfmc_tmds_commit(&bus->chip, 1600, rate, &dry);
+	KUNIT_EXPECT_EQ(test, bus->chip.tmds_mbps, 0);
+	xfmc_tmds_commit(&bus->chip, 1600, rate, NULL);
+	KUNIT_EXPECT_EQ(test, bus->chip.tmds_mbps, 1600);
+
+	/* A rate whose apply failed is never committed */
+	rate = xfmc_tmds_rate(&bus->chip, 3000, NULL);
+	KUNIT_EXPECT_EQ(test, rate, 3000);
+	KUNIT_EXPECT_EQ(test, bus->chip.tmds_mbps, 1600);
+	KUNIT_EXPECT_EQ(test, bus->chip.tmds_changes, 0);
+
+	/* Margins are scaled to the units of the driver */
+	KUNIT_EXPECT_EQ(test, xfmc_tmds_rate(&bus->chip, 1660, NULL), 1650);
+	bus->chip.tmds_scale = 10;
+	KUNIT_EXPECT_EQ(test, xfmc_tmds_rate(&bus->chip, 1800, NULL), 1650);
+	KUNIT_EXPECT_EQ(test, xfmc_tmds_rate(&bus->chip, 1900, NULL), 1900);
+}
+
+static struct kunit_case xfmc_core_test_cases[] = {
+	KUNIT_CASE(xfmc_test_apply_delta),
+	KUNIT_CASE(xfmc_test_apply_error),
+	KUNIT_CASE(xfmc_test_tmds_commit),
+	KUNIT_CASE(xfmc_test_override_invalid),
+	KUNIT_CASE_SLOW(xfmc_test_apply_stress),
+	KUNIT_CASE_SLOW(xfmc_test_override_stress),
+	{}
+};
+
+static struct kunit_suite xfmc_core_test_suite = {
+	.name = "xfmc-core",
+	.init = xfmc_core_test_init,
+	.test_cases = xfmc_core_test_cases,
+};
+
+kunit_test_suites(&xfmc_plan_test_suite, &xfmc_idt_calc_test_suite,
+		  &xfmc_core_test_suite);
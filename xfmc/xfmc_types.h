@@ -0,0 +1,40 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Xilinx Video FMC kernel-agnostic units
+ *
+ * Copyright (C) 2024, Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * idt_calc.c and xfmc_plan.c do no I/O and only use what is defined
+ * here, so that they build both in the module and in userspace
+ * (tools/xfmc-bench).
+ */
+#ifndef __XFMC_TYPES_H__
+#define __XFMC_TYPES_H__
+
+#ifdef __KERNEL__
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/types.h>
+#else
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(a)	(sizeof(a) / sizeof((a)[0]))
+#endif
+
+#define min(a, b)	((a) < (b) ? (a) : (b))
+
+static inline u64 div_u64(u64 dividend, u32 divisor)
+{
+	return dividend / divisor;
+}
+#endif /* __KERNEL__ */
+
+#endif /* __XFMC_TYPES_H__ */